@@ -42,6 +42,15 @@ void AppInterface::draw(float time)
             ImGui::InputInt("Seed", &terrainSeed);
             ImGui::SameLine();
             ImGui::Checkbox("Random", &useRandom);
+            static const char * bakeMethods[] = { "Ray March", "Sweep" };
+
+            if(ImGui::Combo("Shadow Baker", &shadowBakeMethod, bakeMethods, 2))
+            {
+                App::Instance()->getTerrain().BakeMethod(
+                    ShadowmapBaker::Method(shadowBakeMethod)
+                );
+            }
+
             ImGui::InputInt2("##lbk", lightmapFreqAndSize);
             ImGui::SameLine();
             // set proper ranges
@@ -54,6 +63,26 @@ void AppInterface::draw(float time)
                         lightmapFreqAndSize[1]);
             }
 
+            // background baking progress
+            const BakingJob &lightmapJob = App::Instance()->getTerrain().LightmapJob();
+            const BakingJob &horizonJob = App::Instance()->getTerrain().HorizonJob();
+            const BakingJob &occlusionJob = App::Instance()->getTerrain().OcclusionJob();
+
+            if(lightmapJob.Running())
+            {
+                ImGui::Text("Baking Lightmaps %.0f%%", lightmapJob.Progress() * 100.0f);
+            }
+
+            if(horizonJob.Running())
+            {
+                ImGui::Text("Baking Horizon Map %.0f%%", horizonJob.Progress() * 100.0f);
+            }
+
+            if(occlusionJob.Running())
+            {
+                ImGui::Text("Baking Occlusion %.0f%%", occlusionJob.Progress() * 100.0f);
+            }
+
             if(ImGui::Button("Generate Terrain"))
             {
                 if(useRandom) terrainSeed = std::rand();
@@ -67,7 +96,8 @@ void AppInterface::draw(float time)
 
             ImGui::SameLine();
 
-            if(ImGui::Button("Save Heightmap To File"))
+            // file names are suffixed with the current time
+            auto timestamp = []() -> std::string
             {
                 using namespace boost::posix_time;
                 // set string format
@@ -77,8 +107,32 @@ void AppInterface::draw(float time)
                 wss.imbue(loc);
                 // get current time
                 wss << second_clock::universal_time();
+                return wss.str();
+            };
+
+            if(ImGui::Button("Save Heightmap To File"))
+            {
                 // write terrain to file, concatenate timestamp
-                App::Instance()->getTerrain().saveTerrainToFile("terrain" + wss.str());
+                App::Instance()->getTerrain().saveTerrainToFile("terrain" + timestamp());
+            }
+
+            if(ImGui::Button("Save Snapshot"))
+            {
+                App::Instance()->getTerrain().saveSnapshot("terrain" + timestamp()
+                        + TerrainSnapshot::extension);
+            }
+
+            ImGui::SameLine();
+
+            if(ImGui::Button("Load Snapshot"))
+            {
+                static OpenFileDialog *snapshotDialog = new OpenFileDialog();
+
+                // restores the whole terrain, no generation or baking
+                if(snapshotDialog->ShowDialog())
+                {
+                    App::Instance()->getTerrain().loadSnapshot(snapshotDialog->FileName);
+                }
             }
 
             stackedSize = ImGui::GetWindowSize();
@@ -121,6 +175,16 @@ void AppInterface::draw(float time)
                 .TimeScale(timeScale);
             }
 
+            if(ImGui::Checkbox("Depth Pre-Pass", &depthPrePass))
+            {
+                App::Instance()->getTerrain().useDepthPrePass = depthPrePass;
+            }
+
+            if(ImGui::Checkbox("Horizon Shadows", &horizonShadows))
+            {
+                App::Instance()->getTerrain().useHorizonShadows = horizonShadows;
+            }
+
             ImGui::Text("Ambient Occlusion");
 
             if(ImGui::SliderInt("##ao", &occlusionStrenght, 0, 32))
@@ -135,13 +199,48 @@ void AppInterface::draw(float time)
 
             if(geomipmapping)
             {
+                PerformanceGovernor &governor = App::Instance()->getTerrain().Governor();
+                static const char * governorModes[] = { "Manual", "Frame Time", "Triangle Budget" };
                 ImGui::Text("Pixel Error Threeshold");
 
-                if(ImGui::InputFloat("##ett", &geoThreeshold, 0.01, 0.1, 10))
+                if(ImGui::Combo("##gmode", &governorMode, governorModes, 3))
+                {
+                    governor.Mode(PerformanceGovernor::GovernorMode(governorMode));
+                }
+
+                if(governorMode == PerformanceGovernor::Manual)
                 {
-                    ChunkDetailLevel::Threeshold(geoThreeshold);
-                    this->geoThreeshold = std::max(0.0f, geoThreeshold);
+                    if(ImGui::InputFloat("##ett", &geoThreeshold, 0.01, 0.1, 10))
+                    {
+                        ChunkDetailLevel::Threeshold(geoThreeshold);
+                        this->geoThreeshold = std::max(0.0f, geoThreeshold);
+                    }
                 }
+                else
+                {
+                    if(governorMode == PerformanceGovernor::FrameTime
+                       && ImGui::InputFloat("Target (ms)", &targetFrameTime, 0.5f, 2.0f, 2))
+                    {
+                        governor.TargetFrameTime(targetFrameTime);
+                        targetFrameTime = governor.TargetFrameTime();
+                    }
+
+                    if(governorMode == PerformanceGovernor::TriangleBudget
+                       && ImGui::InputInt("Triangles", &triangleBudget, 10000, 100000))
+                    {
+                        governor.TriangleBudget(std::max(1, triangleBudget));
+                        triangleBudget = governor.TriangleBudget();
+                    }
+
+                    // threeshold is driven by the governor now
+                    geoThreeshold = ChunkDetailLevel::Threeshold();
+                    ImGui::Text("Threeshold: %.3f", geoThreeshold);
+                    ImGui::Text("Budget Usage: %.0f%%", governor.BudgetUsage() * 100.0f);
+                }
+
+                ImGui::Text("Terrain GPU %.2f ms, CPU %.2f ms", governor.GpuTime(),
+                            governor.CpuTime());
+                ImGui::Text("Triangles: %u", governor.FrameTriangles());
 
                 if(ImGui::Checkbox("Show Bounding Boxes", &this->showBBoxes))
                 {
@@ -152,6 +251,19 @@ void AppInterface::draw(float time)
                 {
                     TerrainChunk::EnableFrustumCulling(frustumCulling);
                 }
+
+                if(ImGui::Checkbox("Occlusion Culling", &occlusionCulling))
+                {
+                    TerrainChunk::EnableOcclusionCulling(occlusionCulling);
+                }
+
+                if(occlusionCulling)
+                {
+                    TerrainChunksGenerator &chunks =
+                        App::Instance()->getTerrain().chunkGenerator;
+                    ImGui::Text("Occluded: %u of %u", chunks.OcclusionCulled(),
+                                chunks.OcclusionTested());
+                }
             }
 
             ImGui::Checkbox("Pause", &pauseTime);
@@ -276,15 +388,38 @@ void AppInterface::draw(float time)
         }
         // performance window
         {
-            ImGui::SetNextWindowSize(ImVec2(150, 50));
+            // job system workers, sampled once per second
+            if(glfwGetTime() - workerStatsTime >= 1.0)
+            {
+                JobSystem::workerStats(workerStats);
+                JobSystem::resetStats();
+                workerStatsTime = glfwGetTime();
+            }
+
+            float averageUtilization = 0.0f;
+            float busiestUtilization = 0.0f;
+            unsigned int steals = 0;
+
+            for(auto &worker : workerStats)
+            {
+                averageUtilization += worker.utilization / workerStats.size();
+                busiestUtilization = std::max(busiestUtilization, worker.utilization);
+                steals += worker.steals;
+            }
+
+            ImGui::SetNextWindowSize(ImVec2(150, 95));
             ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 150 - 3,
-                                           io.DisplaySize.y - 50 - 3));
+                                           io.DisplaySize.y - 95 - 3));
             ImGui::Begin("Performance Window", nullptr,
                          ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize |
                          ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoSavedSettings);
             ImGui::Text("Performance");
             ImGui::Separator();
             ImGui::Text("FPS: (%.1f)", io.Framerate);
+            ImGui::Text("Workers: %u", (unsigned int)workerStats.size());
+            ImGui::Text("Busy: %.0f%% (max %.0f%%)", averageUtilization * 100.0f,
+                        busiestUtilization * 100.0f);
+            ImGui::Text("Steals: %u/s", steals);
             ImGui::End();
         }
     }
@@ -325,7 +460,14 @@ AppInterface::AppInterface()
     this->lightmapFreqAndSize[1] = 256;
     this->terrainRange[2] = 5.0f;
     this->geoThreeshold = ChunkDetailLevel::Threeshold();
+    this->governorMode = PerformanceGovernor::Manual;
+    this->shadowBakeMethod = ShadowmapBaker::RayMarch;
+    this->targetFrameTime = 8.0f;
+    this->triangleBudget = 500000;
     this->frustumCulling = TerrainChunk::EnableFrustumCulling();
+    this->occlusionCulling = TerrainChunk::EnableOcclusionCulling();
+    this->depthPrePass = false;
+    this->horizonShadows = false;
     this->showBBoxes = TerrainChunk::DrawingBoundingBoxes();
 
     for(int i = 0; i < 4; i++)
@@ -336,6 +478,7 @@ AppInterface::AppInterface()
 
     this->pauseTime = false;
     this->wireframeMode = false;
+    this->workerStatsTime = 0.0;
 }
 
 
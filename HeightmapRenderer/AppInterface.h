@@ -23,8 +23,18 @@ class AppInterface
         int occlusionStrenght;
         bool geomipmapping;
         float geoThreeshold;
+        int governorMode;
+        int shadowBakeMethod;
+        float targetFrameTime;
+        int triangleBudget;
         bool showBBoxes;
         bool frustumCulling;
+        bool occlusionCulling;
+        bool depthPrePass;
+        bool horizonShadows;
+        // last sampled job system worker stats
+        std::vector<JobSystem::WorkerStats> workerStats;
+        double workerStatsTime;
         void initialize(GLFWwindow * window);
         void draw(float time);
         void render();
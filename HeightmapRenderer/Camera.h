@@ -15,23 +15,12 @@ class Camera
         };
         glm::vec4 planes[6];
 
-        inline int vectorToIndex(const glm::vec3 &v) const
-        {
-            int idx = 0;
-
-            if(v.z >= 0) idx |= 1;
-
-            if(v.y >= 0) idx |= 2;
-
-            if(v.x >= 0) idx |= 4;
-
-            return idx;
-        }
-
     public:
         glm::vec4 getPlane(Plane p) const;
+        // the six frustum planes, normal(xyz) offset(w)
+        const glm::vec4 * Planes() const { return planes; }
         void calcPlanes(const glm::mat4 &matrix);
-        int halfPlaneTest(const glm::vec3 &p, const glm::vec3 &normal, float offset);
+        // 0 outside, 1 inside and 3 intersecting the frustum
         int isBoxInFrustum(const glm::vec3 &origin, const glm::vec3 &halfDim);
 
     private:
@@ -1,9 +1,10 @@
 #include "Commons.h"
 #include "ChunkDetailLevel.h"
+#include "TerrainMeshBuilder.h"
 // pixel error, shared among all chunks
 float ChunkDetailLevel::threeshold = 0.35;
 
-void ChunkDetailLevel::generateDetailLevels(int meshSize, int chunkSize)
+void ChunkDetailLevel::setSizes(int meshSize, int chunkSize)
 {
     this->meshSize = meshSize;
     this->chunkSize = chunkSize;
@@ -12,22 +13,27 @@ void ChunkDetailLevel::generateDetailLevels(int meshSize, int chunkSize)
     for(int lodLevel = 0; lodLevel < 3; lodLevel++)
     {
         int nextSize = (chunkSize - 1) / std::pow(2, lodLevel) + 1;
-        int stepMultiplier = std::pow(2, lodLevel);
+        triangleCounts[lodLevel] = 2 * (nextSize - 1) * (nextSize - 1);
+    }
+}
 
-        for(int i = 0; i < nextSize - 1; i++)
-        {
-            for(int j = 0; j < nextSize; j++)
-            {
-                indicesLoD[lodLevel].push_back(
-                    ((i + 1) * chunkSize + j) * stepMultiplier
-                );
-                indicesLoD[lodLevel].push_back(
-                    (i * chunkSize + j) * stepMultiplier
-                );
-            }
+void ChunkDetailLevel::generateDetailLevels(int meshSize, int chunkSize)
+{
+    setSizes(meshSize, chunkSize);
+    TerrainMeshBuilder::buildLoDIndices(meshSize, chunkSize, indicesLoD);
+    indicesCombinationGenerated = true;
+}
 
-            indicesLoD[lodLevel].push_back(restartIndexToken);
-        }
+void ChunkDetailLevel::loadDetailLevels(int meshSize, int chunkSize,
+                                        const unsigned int * const indices[3],
+                                        const size_t counts[3])
+{
+    setSizes(meshSize, chunkSize);
+
+    for(int lodLevel = 0; lodLevel < 3; lodLevel++)
+    {
+        indicesLoD[lodLevel].assign(indices[lodLevel],
+                                    indices[lodLevel] + counts[lodLevel]);
     }
 
     indicesCombinationGenerated = true;
@@ -44,12 +44,16 @@ class ChunkDetailLevel
         Context gl;
         // indices count on level of detail
         std::array<int, 3> indexSizes;
+        // triangles drawn per chunk on level of detail
+        std::array<int, 3> triangleCounts;
         // avoid creating indices again if mesh has the same configuration
         bool indicesCombinationGenerated;
         // indices combinations for different lod levels
         std::array<Buffer, 3> indicesBuffer;
         // thresshold t_
         static float threeshold;
+        // chunk sizes and triangles per level of detail
+        void setSizes(int meshSize, int chunkSize);
     public:
         // uploads index data to gpu
         void bindBufferData();
@@ -57,8 +61,14 @@ class ChunkDetailLevel
         void bindBuffer(LodLevel levelOfDetail);
         // indices count on level of detail
         int indicesSize(LodLevel levelOfDetail);
+        // triangles per chunk on level of detail
+        int trianglesCount(LodLevel levelOfDetail) const { return triangleCounts[std::min(std::max(0, (int)levelOfDetail), 2)]; }
         // generates the 3 LoD indices configurations based on mesh and chunk size
         void generateDetailLevels(int meshSize, int chunkSize);
+        // same as generateDetailLevels with index combinations stored before
+        void loadDetailLevels(int meshSize, int chunkSize,
+                              const unsigned int * const indices[3],
+                              const size_t counts[3]);
         // token to restart the triangle strip
         int RestartIndexToken() const { return restartIndexToken; }
         // indexes combinations per lod
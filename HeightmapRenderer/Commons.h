@@ -1,7 +1,15 @@
 // os specific includes
+#ifdef _WIN32
 #include <windows.h>
 #include <commdlg.h>
 #include <tchar.h>
+#else
+// memory mapped files
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 // opengl and context creation headers
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -30,11 +38,24 @@
 #include <memory>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
 #include <vector>
 #include <algorithm>
 #include <unordered_map>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <array>
+#include <deque>
+#include <functional>
 #include <math.h>
+// sse intrinsics for batched math
+#include <emmintrin.h>
 // glm math library headers
 #include <glm/glm.hpp>
 #include <glm/common.hpp>
@@ -69,8 +90,6 @@
 #include "ImGui/imgui_impl_glfw_gl3.h"
 // image loading library
 #include <FreeImage.h>
-// parallel patterns library (ppl) from Windows for concurrency and parallelism
-#include <ppl.h>
 // namespace assignations
 namespace logging = boost::log;
 namespace src = boost::log::sources;
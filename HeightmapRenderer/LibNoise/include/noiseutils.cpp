@@ -26,7 +26,6 @@
 #include <noise/mathconsts.h>
 
 #include "noiseutils.h"
-#include <ppl.h>
 
 using namespace noise;
 using namespace noise::model;
@@ -0,0 +1,181 @@
+#include "Commons.h"
+#include "OcclusionCuller.h"
+
+const int OcclusionCuller::BufferWidth;
+const int OcclusionCuller::BufferHeight;
+
+void OcclusionCuller::beginFrame(const glm::mat4 &modelViewProjection)
+{
+    this->modelViewProjection = modelViewProjection;
+    std::fill(depthBuffer.begin(), depthBuffer.end(),
+              std::numeric_limits<float>::max());
+    testedCount = 0;
+    culledCount = 0;
+}
+
+bool OcclusionCuller::project(const glm::vec3 &point, glm::vec3 &screen) const
+{
+    glm::vec4 clip = modelViewProjection * glm::vec4(point, 1.0f);
+
+    // behind the eye, nothing conservative can be said
+    if(clip.w <= 1e-4f) return false;
+
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    screen.x = (ndc.x * 0.5f + 0.5f) * BufferWidth;
+    screen.y = (ndc.y * 0.5f + 0.5f) * BufferHeight;
+    screen.z = ndc.z;
+    return true;
+}
+
+void OcclusionCuller::rasterizeQuad(const glm::vec3 * corners)
+{
+    // signed area gives the winding of the projected quad
+    float area = 0.0f;
+    float minX = corners[0].x, maxX = corners[0].x;
+    float minY = corners[0].y, maxY = corners[0].y;
+    float maxDepth = corners[0].z;
+
+    for(int i = 0; i < 4; i++)
+    {
+        const glm::vec3 &a = corners[i];
+        const glm::vec3 &b = corners[(i + 1) % 4];
+        area += a.x * b.y - b.x * a.y;
+        minX = std::min(minX, a.x); maxX = std::max(maxX, a.x);
+        minY = std::min(minY, a.y); maxY = std::max(maxY, a.y);
+        maxDepth = std::max(maxDepth, a.z);
+    }
+
+    // quad seen edge on
+    if(std::abs(area) < 1e-6f) return;
+
+    float winding = area > 0.0f ? 1.0f : -1.0f;
+    // pixel corner bounds clipped to the buffer
+    int x0 = std::max(0, (int)std::floor(minX));
+    int x1 = std::min(BufferWidth, (int)std::ceil(maxX));
+    int y0 = std::max(0, (int)std::floor(minY));
+    int y1 = std::min(BufferHeight, (int)std::ceil(maxY));
+
+    if(x0 >= x1 || y0 >= y1) return;
+
+    int gridWidth = x1 - x0 + 1;
+    int gridHeight = y1 - y0 + 1;
+    cornerInside.resize(gridWidth * gridHeight);
+
+    // evaluate the four edge functions at every pixel corner
+    for(int y = 0; y < gridHeight; y++)
+    {
+        for(int x = 0; x < gridWidth; x++)
+        {
+            float px = (float)(x0 + x);
+            float py = (float)(y0 + y);
+            bool inside = true;
+
+            for(int i = 0; i < 4 && inside; i++)
+            {
+                const glm::vec3 &a = corners[i];
+                const glm::vec3 &b = corners[(i + 1) % 4];
+                float edge = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+                inside = edge * winding >= 0.0f;
+            }
+
+            cornerInside[y * gridWidth + x] = inside;
+        }
+    }
+
+    // a pixel is covered if its four corners are, the quad is convex
+    for(int y = 0; y < gridHeight - 1; y++)
+    {
+        for(int x = 0; x < gridWidth - 1; x++)
+        {
+            if(!cornerInside[y * gridWidth + x]
+               || !cornerInside[y * gridWidth + x + 1]
+               || !cornerInside[(y + 1) * gridWidth + x]
+               || !cornerInside[(y + 1) * gridWidth + x + 1]) continue;
+
+            float &depth = depthBuffer[(y0 + y) * BufferWidth + x0 + x];
+            depth = std::min(depth, maxDepth);
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(const glm::vec3 &boxMin,
+                                 const glm::vec3 &boxMax)
+{
+    testedCount++;
+    float minX = std::numeric_limits<float>::max(), maxX = -minX;
+    float minY = minX, maxY = -minX;
+    float minDepth = minX;
+
+    for(int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner(
+            i & 1 ? boxMax.x : boxMin.x,
+            i & 2 ? boxMax.y : boxMin.y,
+            i & 4 ? boxMax.z : boxMin.z
+        );
+        glm::vec3 screen;
+
+        if(!project(corner, screen)) return false;
+
+        minX = std::min(minX, screen.x); maxX = std::max(maxX, screen.x);
+        minY = std::min(minY, screen.y); maxY = std::max(maxY, screen.y);
+        minDepth = std::min(minDepth, screen.z);
+    }
+
+    // every pixel touched by the box must be covered by a nearer occluder
+    int x0 = std::max(0, (int)std::floor(minX));
+    int x1 = std::min(BufferWidth, (int)std::ceil(maxX));
+    int y0 = std::max(0, (int)std::floor(minY));
+    int y1 = std::min(BufferHeight, (int)std::ceil(maxY));
+
+    if(x0 >= x1 || y0 >= y1) return false;
+
+    for(int y = y0; y < y1; y++)
+    {
+        for(int x = x0; x < x1; x++)
+        {
+            if(depthBuffer[y * BufferWidth + x] >= minDepth) return false;
+        }
+    }
+
+    culledCount++;
+    return true;
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3 &boxMin,
+                                  const glm::vec3 &boxMax)
+{
+    const glm::vec3 &a = boxMin;
+    const glm::vec3 &b = boxMax;
+    // top face and the four sides, the bottom is never visible
+    const glm::vec3 faces[5][4] =
+    {
+        { glm::vec3(a.x, b.y, a.z), glm::vec3(b.x, b.y, a.z), glm::vec3(b.x, b.y, b.z), glm::vec3(a.x, b.y, b.z) },
+        { glm::vec3(a.x, a.y, a.z), glm::vec3(b.x, a.y, a.z), glm::vec3(b.x, b.y, a.z), glm::vec3(a.x, b.y, a.z) },
+        { glm::vec3(a.x, a.y, b.z), glm::vec3(b.x, a.y, b.z), glm::vec3(b.x, b.y, b.z), glm::vec3(a.x, b.y, b.z) },
+        { glm::vec3(a.x, a.y, a.z), glm::vec3(a.x, a.y, b.z), glm::vec3(a.x, b.y, b.z), glm::vec3(a.x, b.y, a.z) },
+        { glm::vec3(b.x, a.y, a.z), glm::vec3(b.x, a.y, b.z), glm::vec3(b.x, b.y, b.z), glm::vec3(b.x, b.y, a.z) }
+    };
+
+    for(int i = 0; i < 5; i++)
+    {
+        glm::vec3 projected[4];
+        bool inFront = true;
+
+        for(int j = 0; j < 4 && inFront; j++)
+        {
+            inFront = project(faces[i][j], projected[j]);
+        }
+
+        if(inFront) rasterizeQuad(projected);
+    }
+}
+
+OcclusionCuller::OcclusionCuller() : depthBuffer(BufferWidth * BufferHeight,
+            std::numeric_limits<float>::max()), testedCount(0), culledCount(0)
+{
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+class OcclusionCuller
+{
+    public:
+        // low resolution depth buffer size
+        static const int BufferWidth = 128;
+        static const int BufferHeight = 64;
+    private:
+        // farthest occluder depth covering each pixel completely, ndc z
+        std::vector<float> depthBuffer;
+        glm::mat4 modelViewProjection;
+        // boxes tested and rejected since the last beginFrame
+        unsigned int testedCount;
+        unsigned int culledCount;
+        // projects a model space point to buffer coordinates and ndc depth,
+        // returns false if the point lies behind the eye
+        bool project(const glm::vec3 &point, glm::vec3 &screen) const;
+        // conservatively rasterizes a convex quad, only fully covered
+        // pixels are written, all with the farthest depth of the quad
+        void rasterizeQuad(const glm::vec3 * corners);
+        // edge test results at pixel corners, reused between quads
+        std::vector<char> cornerInside;
+    public:
+        // clears the depth buffer, boxes and occluders are in model space
+        void beginFrame(const glm::mat4 &modelViewProjection);
+        // true if the box is behind the occluders added so far
+        bool isOccluded(const glm::vec3 &boxMin, const glm::vec3 &boxMax);
+        // adds a solid box as occluder, the box has to lie completely
+        // under the terrain surface so any ray reaching it is blocked
+        void addOccluder(const glm::vec3 &boxMin, const glm::vec3 &boxMax);
+
+        unsigned int TestedCount() const { return testedCount; }
+        unsigned int CulledCount() const { return culledCount; }
+
+        OcclusionCuller();
+        ~OcclusionCuller();
+};
+
@@ -0,0 +1,103 @@
+#include "Commons.h"
+#include "PerformanceGovernor.h"
+#include "ChunkDetailLevel.h"
+
+void PerformanceGovernor::initialize()
+{
+    if(queriesCreated) return;
+
+    glGenQueries(QueryCount, timerQueries.data());
+    queryIssued.fill(false);
+    queriesCreated = true;
+}
+
+void PerformanceGovernor::beginFrame()
+{
+    cpuFrameStart = glfwGetTime();
+
+    if(!queriesCreated) return;
+
+    // the query about to be reused holds the oldest result
+    if(queryIssued[currentQuery]) readTimerQuery(currentQuery);
+
+    glBeginQuery(GL_TIME_ELAPSED, timerQueries[currentQuery]);
+}
+
+void PerformanceGovernor::endFrame(unsigned int trianglesDrawn)
+{
+    if(queriesCreated)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryIssued[currentQuery] = true;
+        currentQuery = (currentQuery + 1) % QueryCount;
+    }
+
+    float frameCpuTime = (float)(glfwGetTime() - cpuFrameStart) * 1000.0f;
+    cpuTime = glm::mix(cpuTime, frameCpuTime, smoothing);
+    frameTriangles = trianglesDrawn;
+    adjustThreeshold();
+}
+
+void PerformanceGovernor::readTimerQuery(int index)
+{
+    GLint available = 0;
+    glGetQueryObjectiv(timerQueries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    // skip this sample instead of stalling
+    if(!available) return;
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(timerQueries[index], GL_QUERY_RESULT, &elapsed);
+    queryIssued[index] = false;
+    gpuTime = glm::mix(gpuTime, (float)(elapsed / 1.0e6), smoothing);
+}
+
+void PerformanceGovernor::adjustThreeshold()
+{
+    if(mode == FrameTime)
+    {
+        // whichever side is slower bounds the frame
+        budgetUsage = std::max(gpuTime, cpuTime) / targetFrameTime;
+    }
+    else if(mode == TriangleBudget)
+    {
+        budgetUsage = glm::mix(budgetUsage, (float)frameTriangles / triangleBudget,
+                               smoothing);
+    }
+    else
+    {
+        return;
+    }
+
+    float threeshold = ChunkDetailLevel::Threeshold();
+
+    // over budget, allow a bigger pixel error
+    if(budgetUsage > 1.0f + hysteresis)
+    {
+        threeshold *= 1.0f + adjustRate * std::min(budgetUsage - 1.0f, 1.0f);
+    }
+    // under budget, bring back detail
+    else if(budgetUsage < 1.0f - hysteresis)
+    {
+        threeshold *= 1.0f - adjustRate * std::min(1.0f - budgetUsage, 1.0f);
+    }
+
+    ChunkDetailLevel::Threeshold(
+        boost::algorithm::clamp(threeshold, minThreeshold, maxThreeshold)
+    );
+}
+
+PerformanceGovernor::PerformanceGovernor() : mode(Manual),
+    targetFrameTime(8.0f), triangleBudget(500000), currentQuery(0),
+    queriesCreated(false), gpuTime(0.0f), cpuTime(0.0f), cpuFrameStart(0.0),
+    frameTriangles(0), budgetUsage(0.0f), smoothing(0.1f), hysteresis(0.1f),
+    adjustRate(0.05f), minThreeshold(0.05f), maxThreeshold(32.0f)
+{
+    timerQueries.fill(0);
+    queryIssued.fill(false);
+}
+
+PerformanceGovernor::~PerformanceGovernor()
+{
+    if(queriesCreated) glDeleteQueries(QueryCount, timerQueries.data());
+}
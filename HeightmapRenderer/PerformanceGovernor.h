@@ -0,0 +1,69 @@
+#pragma once
+
+class PerformanceGovernor
+{
+    public:
+        enum GovernorMode
+        {
+            // pixel error threeshold is set by hand
+            Manual = 0,
+            // holds the terrain pass cost around a frame time target
+            FrameTime,
+            // holds the drawn triangle count around a budget
+            TriangleBudget
+        };
+    private:
+        GovernorMode mode;
+        // target terrain pass time in milliseconds
+        float targetFrameTime;
+        // maximum triangles drawn per frame
+        unsigned int triangleBudget;
+        // gpu timer queries ring, results are read a few
+        // frames later so the cpu never waits for the gpu
+        static const int QueryCount = 4;
+        std::array<GLuint, QueryCount> timerQueries;
+        std::array<bool, QueryCount> queryIssued;
+        int currentQuery;
+        bool queriesCreated;
+        // smoothed measurements in milliseconds
+        float gpuTime;
+        float cpuTime;
+        double cpuFrameStart;
+        // triangles submitted on the last frame
+        unsigned int frameTriangles;
+        // measured cost over the target, 1.0 means on target
+        float budgetUsage;
+        // exponential moving average factor for measurements
+        float smoothing;
+        // no correction while usage stays within 1.0 +- hysteresis
+        float hysteresis;
+        // maximum relative threeshold change per frame
+        float adjustRate;
+        float minThreeshold;
+        float maxThreeshold;
+        // reads the oldest timer query if its result is available
+        void readTimerQuery(int index);
+    public:
+        // creates the gpu timer queries, requires a valid context
+        void initialize();
+        // call around the terrain pass
+        void beginFrame();
+        void endFrame(unsigned int trianglesDrawn);
+        // scales the pixel error threeshold to meet the current target
+        void adjustThreeshold();
+
+        void Mode(GovernorMode val) { mode = val; }
+        GovernorMode Mode() const { return mode; }
+        void TargetFrameTime(float val) { targetFrameTime = std::max(0.1f, val); }
+        float TargetFrameTime() const { return targetFrameTime; }
+        void TriangleBudget(unsigned int val) { triangleBudget = std::max(1u, val); }
+        unsigned int TriangleBudget() const { return triangleBudget; }
+        float GpuTime() const { return gpuTime; }
+        float CpuTime() const { return cpuTime; }
+        unsigned int FrameTriangles() const { return frameTriangles; }
+        float BudgetUsage() const { return budgetUsage; }
+
+        PerformanceGovernor();
+        ~PerformanceGovernor();
+};
+
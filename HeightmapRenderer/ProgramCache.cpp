@@ -0,0 +1,150 @@
+#include "Commons.h"
+#include "ProgramCache.h"
+#include "BakeCache.h"
+
+const char * ProgramCache::directory = "ProgramCache";
+
+std::string ProgramCache::entryPath(std::uint64_t key)
+{
+    std::stringstream path;
+    path << directory << "/" << std::hex << key << ".program";
+    return path.str();
+}
+
+std::uint64_t ProgramCache::programKey(const std::string &vertexSource,
+                                       const std::string &fragmentSource)
+{
+    std::uint64_t key = BakeCache::hash(vertexSource.data(), vertexSource.size());
+    // separate the stages so moving text between them changes the key
+    const char separator = 0;
+    key = BakeCache::hash(&separator, 1, key);
+    key = BakeCache::hash(fragmentSource.data(), fragmentSource.size(), key);
+    // a driver update may change or invalidate its binary format
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+
+    for(auto name : names)
+    {
+        const char * value = (const char *)glGetString(name);
+
+        if(value) key = BakeCache::hash(value, std::strlen(value), key);
+    }
+
+    return key;
+}
+
+bool ProgramCache::binariesSupported()
+{
+    if(!GLEW_ARB_get_program_binary) return false;
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+bool ProgramCache::load(Program &program, std::uint64_t key)
+{
+    MappedFile file;
+
+    if(!file.open(entryPath(key))) return false;
+
+    if(file.Size() < sizeof(EntryHeader)) return false;
+
+    EntryHeader header;
+    std::memcpy(&header, file.Data(), sizeof(EntryHeader));
+
+    if(std::memcmp(header.magic, "TPRG", 4) != 0
+       || header.version != version
+       || header.key != key
+       || file.Size() < sizeof(EntryHeader) + header.binarySize)
+    {
+        return false;
+    }
+
+    GLuint name = GetGLName(program);
+    glProgramBinary(name, header.binaryFormat,
+                    file.Data() + sizeof(EntryHeader), header.binarySize);
+    // an unknown format raises an error, don't leave it to the next
+    // checked call
+    while(glGetError() != GL_NO_ERROR);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(name, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+bool ProgramCache::store(Program &program, std::uint64_t key)
+{
+    GLuint name = GetGLName(program);
+    GLint binarySize = 0;
+    glGetProgramiv(name, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+
+    if(binarySize <= 0) return false;
+
+    std::vector<unsigned char> binary(binarySize);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(name, binarySize, nullptr, &binaryFormat, binary.data());
+#ifdef _WIN32
+    CreateDirectoryA(directory, NULL);
+#else
+    mkdir(directory, 0755);
+#endif
+    EntryHeader header;
+    std::memcpy(header.magic, "TPRG", 4);
+    header.version = version;
+    header.binaryFormat = binaryFormat;
+    header.binarySize = binarySize;
+    header.key = key;
+    return MappedFile::replace(entryPath(key), [&](std::ostream & output)
+    {
+        output.write((const char *)&header, sizeof(EntryHeader));
+        output.write((const char *)binary.data(), binary.size());
+    });
+}
+
+void ProgramCache::link(Program &program, const std::string &vertexSource,
+                        const std::string &fragmentSource)
+{
+    bool cacheable = binariesSupported();
+    std::uint64_t key = 0;
+
+    if(cacheable)
+    {
+        key = programKey(vertexSource, fragmentSource);
+
+        if(load(program, key)) return;
+
+        // must be set before linking for the binary to be retrievable
+        glProgramParameteri(GetGLName(program),
+                            GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // rejected or missing binary, build from source
+    VertexShader vertexShader;
+    vertexShader.Source((GLSLString)vertexSource.c_str());
+    vertexShader.Compile();
+    FragmentShader fragmentShader;
+    fragmentShader.Source((GLSLString)fragmentSource.c_str());
+    fragmentShader.Compile();
+    program.AttachShader(vertexShader);
+    program.AttachShader(fragmentShader);
+    program.Link();
+    // the linked program keeps working without its shaders
+    program.DetachShader(vertexShader);
+    program.DetachShader(fragmentShader);
+
+    if(cacheable) store(program, key);
+}
+
+std::string ProgramCache::loadSource(const std::string &filename)
+{
+    std::ifstream input(filename, std::ios::binary);
+
+    if(!input)
+    {
+        throw std::runtime_error("Couldn't open shader source " + filename);
+    }
+
+    std::stringstream source;
+    source << input.rdbuf();
+    return source.str();
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "MappedFile.h"
+
+// linked program binaries stored on disk, entries are keyed by a hash
+// of the shader sources and the driver that produced them
+class ProgramCache
+{
+    private:
+        static const char * directory;
+        // bump when the entry layout changes
+        static const std::uint32_t version = 1;
+        struct EntryHeader
+        {
+            char magic[4];
+            std::uint32_t version;
+            std::uint32_t binaryFormat;
+            std::uint32_t binarySize;
+            std::uint64_t key;
+        };
+        static std::string entryPath(std::uint64_t key);
+        // sources and vendor, renderer and version strings
+        static std::uint64_t programKey(const std::string &vertexSource,
+                                        const std::string &fragmentSource);
+        // true if the driver accepted the stored binary
+        static bool load(Program &program, std::uint64_t key);
+        static bool store(Program &program, std::uint64_t key);
+        // false if the driver exposes no binary formats
+        static bool binariesSupported();
+    public:
+        // links program from vertex and fragment sources, the binary from
+        // a previous run is used if the driver accepts it, otherwise the
+        // sources are compiled and the result stored for the next run.
+        // program must not have shaders attached
+        static void link(Program &program, const std::string &vertexSource,
+                         const std::string &fragmentSource);
+        // whole text of a shader file
+        static std::string loadSource(const std::string &filename);
+};
+
@@ -0,0 +1,19 @@
+#version 330
+
+// leading member of the terrain FrameUniforms block, std140 keeps its
+// offset so both programs read the same buffer
+layout(std140) uniform FrameUniforms
+{
+    mat4 modelViewProjection;
+} frame;
+
+// same attribute location as terrain.vert
+layout(location = 0) in vec3 vertexPosition;
+
+// must match the terrain.vert depth exactly
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = frame.modelViewProjection * vec4(vertexPosition, 1.0f);
+}
@@ -4,30 +4,49 @@
 
 const int MAX_POINT_LIGHTS = 2;
 const int MAX_SPOT_LIGHTS = 2;
+const int MAX_TERRAIN_TEXTURE_RANGES = 4;
+
+// per frame values, written once per frame by Terrain::setProgramUniforms,
+// must match Terrain::FrameUniforms and be the same in every stage
+layout(std140) uniform FrameUniforms
+{
+    mat4 modelViewProjection;
+    mat4 modelView;
+    mat4 normalMatrix;
+    // xyz camera space light direction
+    vec4 lightDirection;
+    vec4 lightIntensities;
+    // x current lightmap, y first valid slice, z valid slice count
+    vec4 lightmaps;
+    // xy sun sector coordinate and elevation, z horizon shadows enabled
+    vec4 sunHorizon;
+    // min, max, active > 0.0
+    vec4 terrainRange[MAX_TERRAIN_TEXTURE_RANGES];
+} frame;
 
 float shadowing = 1.0f;
 float occlusion = 1.0f;
 
-uniform float currentLightmap = 0.0f;
 uniform float occlusionStrength = 4.0f;
+// baked horizon based ambient occlusion, 1.0 is open sky
+uniform sampler2D ambientOcclusionMap;
+// mesh space normal x and z at heightmap resolution
+uniform sampler2D normalMap;
 
-uniform sampler3D bakedLightmaps;
+// one bc4 layer per slice with baked penumbrae
+uniform sampler2DArray bakedLightmaps;
 uniform sampler2D realTimeLightmap;
 uniform sampler2D heightmapField;
 uniform vec2 terrainUVScaling = vec2(25, 25);
-uniform vec2 terrainMapSize = vec2(256, 256);
-uniform vec2 lightmapSize = vec2(256, 256);
 
-const int MAX_TERRAIN_TEXTURE_RANGES = 4;
+const int HORIZON_SECTORS = 16;
+// four sectors per layer, horizon elevation normalized to 0..1
+uniform sampler2DArray horizonMap;
+
 uniform sampler2DArray terrainTextures;
-uniform vec3 terrainRange[MAX_TERRAIN_TEXTURE_RANGES] =
-{
-    // min, max, active > 0.0
-    vec3(0.0, 0.1, -1.0),
-    vec3(0.1, 0.3, -1.0),
-    vec3(0.3, 0.7, -1.0),
-    vec3(0.7, 1.0, -1.0)
-};
+// baked range weights, four ranges per layer
+const int SPLAT_LAYERS = (MAX_TERRAIN_TEXTURE_RANGES + 3) / 4;
+uniform sampler2DArray splatMap;
 
 vec3 heightSample[MAX_TERRAIN_TEXTURE_RANGES] =
 {
@@ -49,11 +68,11 @@ struct BaseLight
     vec3 intensities;
 };
 
-uniform struct DirectionalLight
+struct DirectionalLight
 {
     BaseLight base;
     vec3 direction;
-} directionalLight;
+};
 
 uniform struct PointLight
 {
@@ -83,15 +102,6 @@ uniform struct Material
     float shininessStrength;
 } material;
 
-uniform struct Matrices
-{
-    mat4 modelView;
-    mat4 modelViewProjection;
-    mat4 model;
-    mat4 view;
-    mat4 projection;
-    mat4 normal;
-} matrix;
 
 uniform struct LightParams
 {
@@ -222,77 +232,115 @@ vec3 calculateDirectionalLight(DirectionalLight lightSource, vec3 position,
     return ambient + (specular + diffuse) * shadowing * occlusion;
 }
 
-vec3 generateTerrainColor(float height, vec2 texCoord)
+vec3 rangeColor(int range, vec2 terrainUV)
 {
-    vec3 terrainColor = vec3(0.0);
-    vec3 terrainSurfaceColor = vec3(0.0);
-    float regionMin = 0.0;
-    float regionMax = 0.0;
-    float regionRange = 0.0;
-    float regionWeight = 0.0;
-    vec2 terrainUV = texCoord * terrainUVScaling;
-
-    for(int i = 0; i < MAX_TERRAIN_TEXTURE_RANGES; i++)
-    {
-        regionMin = terrainRange[i].x;
-        regionMax = terrainRange[i].y;
-        regionRange = regionMax - regionMin;
-        regionWeight = max(0.0, (regionRange - abs(height - regionMax)) / regionRange);
-        terrainSurfaceColor = terrainRange[i].z > 0.0
-                              ? texture(terrainTextures, vec3(terrainUV, i)).rgb
-                              : heightSample[i];
-        terrainColor += regionWeight * terrainSurfaceColor;
-    }
-
-    return terrainColor;
+    return frame.terrainRange[range].z > 0.0
+           ? texture(terrainTextures, vec3(terrainUV, range)).rgb
+           : heightSample[range];
 }
 
-float terrainShadow(vec2 texCoord)
+vec3 generateTerrainColor(vec2 texCoord)
 {
-    float sum = 0.0;
-    float x, y;
-    float xOffset = 1.0 / lightmapSize.x;
-    float yOffset = 1.0 / lightmapSize.y;
+    // the two heaviest baked range weights
+    float weight[2] = float[2](0.0, 0.0);
+    int range[2] = int[2](0, 0);
+    float totalWeight = 0.0;
 
-    for(y = -1; y <= 1; y += 1.0)
+    for(int layer = 0; layer < SPLAT_LAYERS; layer++)
     {
-        for(x = -1; x <= 1; x += 1.0)
+        vec4 weights = texture(splatMap, vec3(texCoord, layer));
+
+        for(int c = 0; c < 4 && layer * 4 + c < MAX_TERRAIN_TEXTURE_RANGES; c++)
         {
-            vec2 offsets = vec2(x * xOffset, y * yOffset);
-            sum += texture(bakedLightmaps, vec3(texCoord + offsets, currentLightmap)).r;
+            totalWeight += weights[c];
+
+            if(weights[c] > weight[0])
+            {
+                weight[1] = weight[0];
+                range[1] = range[0];
+                weight[0] = weights[c];
+                range[0] = layer * 4 + c;
+            }
+            else if(weights[c] > weight[1])
+            {
+                weight[1] = weights[c];
+                range[1] = layer * 4 + c;
+            }
         }
     }
 
-    return 1.0 - sum / 16.0;
+    float topWeight = weight[0] + weight[1];
+
+    if(topWeight <= 0.0) return vec3(0.0);
+
+    vec2 terrainUV = texCoord * terrainUVScaling;
+    vec3 terrainColor = weight[0] * rangeColor(range[0], terrainUV)
+                        + weight[1] * rangeColor(range[1], terrainUV);
+    // the dropped ranges still add their brightness
+    return terrainColor * (totalWeight / topWeight);
+}
+
+float lightmapCoordinate()
+{
+    float slices = float(textureSize(bakedLightmaps, 0).z);
+
+    float currentLightmap = frame.lightmaps.x;
+    // first baked lightmap slice and how many follow it, wrapping around the day
+    vec2 validLightmaps = frame.lightmaps.yz;
+
+    if(validLightmaps.y >= slices) return currentLightmap;
+
+    // slice position relative to the first valid slice center
+    float slice = mod(currentLightmap * slices - 0.5 - validLightmaps.x, slices);
+    float last = validLightmaps.y - 1.0;
+
+    // not baked yet, use the nearest valid slice
+    if(slice > last) slice = slice - last < slices - slice ? last : 0.0;
+
+    return (validLightmaps.x + slice + 0.5) / slices;
 }
 
-vec3 getHeightmapPosition(float x, float y, vec2 texCoord){
-    vec2 uv = (texCoord.xy + vec2(x, y)); 
-    float h = texture2D(heightmapField, uv).x;
-    return vec3(uv.x, h, uv.y);
+float terrainShadow(vec2 texCoord)
+{
+    // nothing baked yet
+    if(frame.lightmaps.z < 1.0) return 1.0;
+
+    float slices = float(textureSize(bakedLightmaps, 0).z);
+    // array layers don't filter across, blend the two nearest slices
+    float slice = lightmapCoordinate() * slices - 0.5;
+    float layer = mod(floor(slice), slices);
+    float nextLayer = mod(layer + 1.0, slices);
+    // penumbrae are baked, full shadow is stored as 0.75
+    float shadow = mix(texture(bakedLightmaps, vec3(texCoord, layer)).r,
+                       texture(bakedLightmaps, vec3(texCoord, nextLayer)).r,
+                       fract(slice));
+    return 1.0 - shadow * 0.5625;
 }
 
-float terrainOcclusion(vec3 position, vec3 normal, vec2 texCoord, float rayLength)
+float horizonElevation(vec2 texCoord, int sector)
 {
-    float occlusion = 0.0f;
-    mat3 orthobasis = mat3(matrix.normal);
+    return texture(horizonMap, vec3(texCoord, sector / 4))[sector % 4];
+}
 
-    for(int i = 1; i < 17; i++)
-    {
-        float s = float(i) / 16.0f;
-        float a = sqrt(s * terrainMapSize.x);
-        float b = sqrt(s);
-        float x = sin(a) * b * rayLength;
-        float y = cos(a) * b * rayLength;
-        vec3 sampleUV = orthobasis * vec3(x, 0.0, y);
-        vec3 samplePos = getHeightmapPosition(sampleUV.x, sampleUV.z, texCoord);
-        vec3 sampleDir = normalize(samplePos - position);
-        float lambertian = clamp(dot(normal, sampleDir), 0.0f, 1.0f);
-        float distFactor = 0.23f / sqrt(length(samplePos - position));
-        occlusion += distFactor * lambertian;
-    }
+float horizonShadow(vec2 texCoord)
+{
+    vec2 sunHorizon = frame.sunHorizon.xy;
+    int sector = int(sunHorizon.x);
+    float horizon = mix(horizonElevation(texCoord, sector % HORIZON_SECTORS),
+                        horizonElevation(texCoord, (sector + 1) % HORIZON_SECTORS),
+                        fract(sunHorizon.x));
+    // soft transition hides the 8 bit quantization
+    float lit = smoothstep(horizon - 0.02, horizon + 0.02, sunHorizon.y);
+    // same darkness as a fully shadowed baked lightmap
+    return mix(0.58, 1.0, lit);
+}
 
-    return max(0.0, (1.0 - occlusion / 32.0));
+vec3 terrainNormal(vec2 texCoord)
+{
+    // the surface always faces up, y is rebuilt from x and z
+    vec2 xz = texture(normalMap, texCoord).rg;
+    vec3 meshNormal = vec3(xz.x, sqrt(max(0.0, 1.0 - dot(xz, xz))), xz.y);
+    return normalize((frame.normalMatrix * vec4(meshNormal, 0.0)).xyz);
 }
 
 // Vertex shader inputs
@@ -305,19 +353,22 @@ layout(location = 0) out vec4 fragColor;
 
 void main()
 {
-    vec3 surfaceNormal = normalize(normal);
-    vec3 surfaceColor = generateTerrainColor(height, texCoord);
+    // per pixel normals, lighting detail doesn't depend on the mesh
+    vec3 surfaceNormal = terrainNormal(texCoord);
+    vec3 surfaceColor = generateTerrainColor(texCoord);
     vec3 materialSpecular = material.specular * material.shininessStrength * height;
     // shader variables
-    shadowing = terrainShadow(texCoord);
+    shadowing = frame.sunHorizon.z > 0.0 ? horizonShadow(texCoord)
+                : terrainShadow(texCoord);
 
     if(occlusionStrength > 0.0f)
     {
-        occlusion = terrainOcclusion(position, surfaceNormal, texCoord, 10.0f);
         // occlusion strength
-        occlusion = pow(occlusion, occlusionStrength);
+        occlusion = pow(texture(ambientOcclusionMap, texCoord).r, occlusionStrength);
     }
 
+    DirectionalLight directionalLight = DirectionalLight(
+            BaseLight(frame.lightIntensities.rgb), frame.lightDirection.xyz);
     // total light from all light sources
     vec3 totalLight = calculateDirectionalLight(directionalLight, position,
                       surfaceNormal, surfaceColor, materialSpecular);
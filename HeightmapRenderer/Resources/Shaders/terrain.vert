@@ -106,21 +106,30 @@ float snoise(vec3 v)
   }
 
 /////////////////////////////////////////////////////////////////
-uniform struct Matrices
+const int MAX_TERRAIN_TEXTURE_RANGES = 4;
+
+// per frame values, written once per frame by Terrain::setProgramUniforms,
+// must match Terrain::FrameUniforms and be the same in every stage
+layout(std140) uniform FrameUniforms
 {
-    mat4 modelView;
     mat4 modelViewProjection;
-    mat4 model;
-    mat4 view;
-    mat4 projection;
-    mat4 normal;
-} matrix;
-
-uniform sampler3D bakedLightmaps;
+    mat4 modelView;
+    mat4 normalMatrix;
+    // xyz camera space light direction
+    vec4 lightDirection;
+    vec4 lightIntensities;
+    // x current lightmap, y first valid slice, z valid slice count
+    vec4 lightmaps;
+    // xy sun sector coordinate and elevation, z horizon shadows enabled
+    vec4 sunHorizon;
+    // min, max, active > 0.0
+    vec4 terrainRange[MAX_TERRAIN_TEXTURE_RANGES];
+} frame;
+
+uniform sampler2DArray bakedLightmaps;
 uniform sampler2D realTimeLightmap;
 uniform sampler2D heightmapField;
 uniform vec2 terrainUVScaling = vec2(25, 25);
-uniform vec2 terrainMapSize = vec2(256, 256);
 
 uniform float currentTime = 1.0f;
 
@@ -135,6 +144,9 @@ out vec3 normal;
 out vec3 position;
 out float height;
 
+// the depth pre-pass in depth.vert must produce the exact same depth
+invariant gl_Position;
+
 void main()
 {
     vec4 vertexPos = vec4(vertexPosition, 1.0f);
@@ -142,8 +154,8 @@ void main()
     height = vertexPosition.y;
 
     texCoord = vertexTexCoords;
-    normal = normalize(matrix.normal * vec4(vertexNormal, 0.0f)).xyz;
-    position = vec3(matrix.modelView * vertexPos);
+    normal = normalize(frame.normalMatrix * vec4(vertexNormal, 0.0f)).xyz;
+    position = vec3(frame.modelView * vertexPos);
 
-    gl_Position = matrix.modelViewProjection * vertexPos;
+    gl_Position = frame.modelViewProjection * vertexPos;
 }
\ No newline at end of file
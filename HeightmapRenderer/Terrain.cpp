@@ -2,29 +2,18 @@
 #include "Terrain.h"
 #include "TransformationMatrices.h"
 #include "ChunkDetailLevel.h"
+#include "App.h"
+#include "ProgramCache.h"
+#include "TerrainSnapshot.h"
+#include "Parallel.h"
 using namespace boost::algorithm;
 
+const GLuint Terrain::FrameUniformsBinding;
+
 glm::vec3 Terrain::calculateLightDir(float time)
 {
-    float dirX = std::sin(time) + 0.3f;
-    float dirZ = 0.7f;
-    // scale to 0 -> 1
-    float dirY = (std::cos(time) + sunTime) / (1.0f + sunTime);
-
-    // scale to 0 -> -1
-    if(dirY < 0.0f)
-    {
-        float minimum = (1.0f - sunTime) / (1.0f + sunTime);
-        dirY = dirY / minimum;
-        // moon comes from other side, slowly
-        dirX += std::cos(time) * 0.25;
-    }
-
-    // scale moon and sun altitudes
-    if(dirY > 0.0) dirY *= sunAltitude;
-    else dirY *= moonAltitude;
-
-    return glm::vec3(dirX, std::abs(dirY), dirZ);
+    return ShadowmapBaker::lightDirection(time, sunTime, sunAltitude,
+                                          moonAltitude);
 }
 
 void Terrain::calculateLightDir(float time, glm::vec3 &outDir,
@@ -98,61 +87,136 @@ void Terrain::render(float time)
 {
     if(!meshCreated) return;
 
+    // measures the terrain pass for the lod governor
+    governor.beginFrame();
+    unsigned int trianglesDrawn = 0;
     // reset original state
     program.Use();
     gl.Enable(Capability::DepthTest);
     gl.Enable(Capability::CullFace);
     gl.FrontFace(FaceOrientation::CW);
     gl.CullFace(Face::Back);
+    // publish bakes and textures finished since the last frame
+    uploadBakedLightmaps();
+    terrainTextures.uploadLoadedTextures();
+
+    if(splatMapDirty) createSplatMap();
+
     // set shader uniforms
     setProgramUniforms(time);
 
     if(this->useLoDChunks)
     {
-        // not using quadtree yet
-        for(int i = 0; i < chunkGenerator.ChunkCount(); i++)
+        Camera &camera = App::Instance()->getCamera();
+        // not using quadtree yet, cull all chunks in one pass
+        chunkGenerator.cullChunks(camera);
+        chunkGenerator.selectLoDLevels(camera, terrainHorizontalScale);
+    }
+
+    if(this->useDepthPrePass)
+    {
+        depthProgram.Use();
+        gl.ColorMask(false, false, false, false);
+        drawTerrainGeometry(depthProgram);
+        gl.ColorMask(true, true, true, true);
+        // depth is final, shade only the nearest surface
+        gl.DepthFunc(CompareFunction::LEqual);
+        gl.DepthMask(false);
+        program.Use();
+    }
+
+    trianglesDrawn = drawTerrainGeometry(program);
+
+    if(this->useDepthPrePass)
+    {
+        gl.DepthFunc(CompareFunction::Less);
+        gl.DepthMask(true);
+    }
+
+    // changes the current program, draw bboxes around the chunks
+    if(this->useLoDChunks && TerrainChunk::DrawingBoundingBoxes())
+    {
+        for(unsigned int i = 0; i < chunkGenerator.VisibleCount(); i++)
         {
-            for(int j = 0; j < chunkGenerator.ChunkCount(); j++)
-            {
-                chunkGenerator.MeshChunk(j, i).DrawingBoundingBoxes() ? program.Use() : 0;
-                chunkGenerator.MeshChunk(j, i).drawElements(program);
-            }
+            chunkGenerator.VisibleChunk(i).drawBoundingBox();
         }
     }
-    else
+
+    governor.endFrame(trianglesDrawn);
+
+    if(horizonJob.collect())
     {
-        bindBuffers();
-        // draw mesh
-        gl.DrawElements(
-            PrimitiveType::TriangleStrip,
-            indexSize,
-            DataType::UnsignedInt
-        );
+        createHorizonTexture(horizonMapData.data(), horizonMapResolution);
+        // free temporal data once uploaded to gpu
+        std::vector<unsigned char>().swap(horizonMapData);
+    }
+
+    if(occlusionJob.collect())
+    {
+        createOcclusionTexture(occlusionMapData.data(), occlusionMapResolution);
+        std::vector<unsigned char>().swap(occlusionMapData);
+        BOOST_LOG_TRIVIAL(info) << "Baking Done, ambient occlusion map created";
+    }
+}
+
+unsigned int Terrain::drawTerrainGeometry(Program &drawProgram)
+{
+    if(this->useLoDChunks)
+    {
+        // chunks come front to back from the culling pass
+        for(unsigned int i = 0; i < chunkGenerator.VisibleCount(); i++)
+        {
+            chunkGenerator.VisibleChunk(i).drawElements(drawProgram);
+        }
+
+        return chunkGenerator.VisibleTriangles();
     }
 
-    // update lightmap texture once baking done
-    if(bakingDone) createTOTD3DTexture();
+    bindBuffers();
+    // draw mesh
+    gl.DrawElements(
+        PrimitiveType::TriangleStrip,
+        indexSize,
+        DataType::UnsignedInt
+    );
+    return 2 * (meshResolution - 1) * (meshResolution - 1);
 }
 
 void Terrain::setProgramUniforms(float time)
 {
     static glm::vec3 lightColor, lightDir;
-    static glm::vec4 lightDirectionCameraSpace;
-    // terrain multitexture per height
-    this->terrainTextures.SetUniforms(program);
     // lighting calculations
     calculateLightDir(time * timeScale, lightDir, lightColor);
-    lightDirectionCameraSpace = (TransformationMatrices::View()
-                                 * glm::vec4(lightDir, 0.0f));
     // lighting
-    lightDirection.Set(glm::vec3(lightDirectionCameraSpace));
-    lightIntensities.Set(lightColor);
-    // set scene matrices uniforms
-    modelViewProjection.Set(TransformationMatrices::ModelViewProjection());
-    modelView.Set(TransformationMatrices::ModelView());
-    normalMatrix.Set(TransformationMatrices::Normal());
+    frameUniforms.lightDirection = TransformationMatrices::View()
+                                   * glm::vec4(lightDir, 0.0f);
+    frameUniforms.lightIntensities = glm::vec4(lightColor, 1.0f);
+    // set scene matrices
+    frameUniforms.modelViewProjection = TransformationMatrices::ModelViewProjection();
+    frameUniforms.modelView = TransformationMatrices::ModelView();
+    frameUniforms.normalMatrix = TransformationMatrices::Normal();
     // shader time handler
-    currentLightmap.Set(fmod(time * timeScale, 3.14 * 2.0f) / (3.14 * 2.0f));
+    currentTime = time * timeScale;
+    frameUniforms.lightmaps = glm::vec4(
+                                  fmod(currentTime, glm::two_pi<float>()) / glm::two_pi<float>(),
+                                  (float)validSliceFirst, (float)validSliceCount, 0.0f);
+    // continuous sun shadows from the horizon map
+    frameUniforms.sunHorizon = glm::vec4(horizonCoordinates(lightDir),
+                                         useHorizonShadows ? 1.0f : 0.0f, 0.0f);
+    // terrain multitexture per height
+    const GLfloat * ranges = terrainTextures.Ranges();
+
+    for(int i = 0; i < TerrainMultiTexture::MAX_TERRAIN_TEXTURE_RANGES; i++)
+    {
+        frameUniforms.terrainRange[i] = glm::vec4(ranges[i * 3], ranges[i * 3 + 1],
+                                        ranges[i * 3 + 2], 0.0f);
+    }
+
+    // one upload for every per frame value, re-specifying the storage
+    // lets the driver skip waiting on the previous frame
+    frameUniformBuffer.Bind(Buffer::Target::Uniform);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), &frameUniforms,
+                 GL_STREAM_DRAW);
 }
 
 void Terrain::bindBuffers()
@@ -203,177 +267,12 @@ void Terrain::fastGenerateShadowmapParallel(glm::vec3 lightDir,
 {
     if(!heightmapCreated) return;
 
-    if(glm::length2(lightDir) == 0.0) return;
-
-    // initialize shadow map
-    lightmap = std::vector<unsigned char>(lightmapSize * lightmapSize);
-    // create flag buffer to indicate where we've been
-    std::vector<float> flagMap(lightmapSize * lightmapSize);
-    // calculate absolute values for light direction
-    float lightDirXMagnitude = lightDir[0];
-    float lightDirZMagnitude = lightDir[2];
-
-    if(lightDirXMagnitude < 0) lightDirXMagnitude *= -1;
-
-    if(lightDirZMagnitude < 0) lightDirZMagnitude *= -1;
-
-    float distanceStep = std::sqrt(lightDir[0] * lightDir[0] + lightDir[1] *
-                                   lightDir[1]);
-    // decide which loop will come first, the y loop or x loop
-    // based on direction of light, makes calculations faster
-    // outer loop
-    float sFactor = (float)terrainResolution / lightmapSize;
-    concurrency::parallel_for(int(0), (int)lightmapSize, [&](int y)
-    {
-        int *X, *Y;
-        int iX, iY;
-        int dirX, dirY;
-
-        // this might seem like a waste, why calculate it here? you can calculate it before...
-        // that's because threading is really picky about sharing variables. the less you share,
-        // the faster it goes.
-        if(lightDirXMagnitude > lightDirZMagnitude)
-        {
-            Y = &iX;
-            X = &iY;
-
-            if(lightDir[0] < 0)
-                dirY = -1;
-            else
-                dirY = 1;
-
-            if(lightDir[2] < 0)
-                dirX = -1;
-            else
-                dirX = 1;
-        }
-        else
-        {
-            Y = &iY;
-            X = &iX;
-
-            if(lightDir[0] < 0)
-                dirX = -1;
-            else
-                dirX = 1;
-
-            if(lightDir[2] < 0)
-                dirY = -1;
-            else
-                dirY = 1;
-        }
-
-        // if you decide to just do it single-threaded,
-        // just copy the previous block back just above the for loop
-
-        if(dirY < 0)
-            iY = lightmapSize - y - 1;
-        else
-            iY = y;
-
-        // inner loop
-        for(unsigned int x = 0; x < lightmapSize; x++)
-        {
-            if(dirX < 0)
-                iX = lightmapSize - x - 1;
-            else
-                iX = x;
-
-            float px, py, height, distance, origX, origY;
-            int index;
-            // travel along the terrain until we:
-            // (1) intersect another point
-            // (2) find another point with previous collision data
-            // (3) or reach the edge of the map
-            px = (float) * X;
-            py = (float) * Y;
-            origX = px;
-            origY = py;
-            index = (*Y) * lightmapSize + (*X);
-            distance = 0.0f;
-
-            // travel along ray
-            while(1)
-            {
-                px -= lightDir[0];
-                py -= lightDir[2];
-
-                // check if we've reached the boundary
-                if(px < 0 || px >= lightmapSize - 1 || py < 0 ||
-                   py >= lightmapSize - 1)
-                {
-                    flagMap[index] = -1;
-                    break;
-                }
-
-                // calculate interpolated values
-                int x0, x1, y0, y1;
-                float du, dv;
-                float interpolatedHeight, interpolatedFlagMap;
-                float invdu, invdv;
-                float w0, w1, w2, w3;
-                x0 = int(px);
-                y0 = int(py);
-                x1 = x0 + 1;
-                y1 = y0 + 1;
-                du = px - x0;
-                dv = py - y0;
-                invdu = 1.0f - du;
-                invdv = 1.0f - dv;
-                w0 = invdu * invdv;
-                w1 = invdu * dv;
-                w2 = du * invdv;
-                w3 = du * dv;
-                // compute interpolated height value from the heightmap direction below ray
-                interpolatedHeight =
-                    w0 * clamp(heightmap.getValue(x0 * sFactor, y0 * sFactor), 0.0, 1.0) * 255.0f
-                    + w1 * clamp(heightmap.getValue(x0 * sFactor, y1 * sFactor), 0.0, 1.0) * 255.0f
-                    + w2 * clamp(heightmap.getValue(x1 * sFactor, y0 * sFactor), 0.0, 1.0) * 255.0f
-                    + w3 * clamp(heightmap.getValue(x1 * sFactor, y1 * sFactor), 0.0, 1.0) * 255.0f;
-                // compute interpolated flagmap value from point directly below ray
-                interpolatedFlagMap = w0 * flagMap[y0 * lightmapSize + x0]
-                                      + w1 * flagMap[y1 * lightmapSize + x0]
-                                      + w2 * flagMap[y0 * lightmapSize + x1]
-                                      + w3 * flagMap[y1 * lightmapSize + x1];
-                // get distance from original point to current point
-                //distance = sqrtf( (px-origX)*(px-origX) + (py-origY)*(py-origY) );
-                distance += distanceStep;
-                // get height at current point while traveling along light ray
-                height = clamp(heightmap.getValue(*X * sFactor, *Y * sFactor), 0.0, 1.0)
-                         * 255.0f + lightDir[1] * distance;
-                // check intersection with either terrain or flagMap
-                // if interpolatedHeight is less than interpolatedFlagMap that means
-                // we need to use the flagMap value instead
-                // else use the height value
-                float val;
-
-                if(interpolatedHeight < interpolatedFlagMap) val = interpolatedFlagMap;
-                else val = interpolatedHeight;
-
-                if(height < val)
-                {
-                    flagMap[index] = val - height;
-                    lightmap[index] = 192;
-                    break;
-                }
-
-                // check if pixel we've moved to is unshadowed
-                // since the flagMap value we're using is interpolated, we will be in
-                // between shadowed and unshadowed areas
-                // to compensate for this, simply define some epsilon value and use
-                // this as an offset from -1 to decide
-                // if current point under the ray is unshadowed
-                static float epsilon = 0.5f;
-
-                if(interpolatedFlagMap < -1.0f + epsilon &&
-                   interpolatedFlagMap > -1.0f - epsilon)
-                {
-                    flagMap[index] = -1.0f;
-                    break;
-                }
-            }
-        }
-    });
+    std::vector<float> heights;
+    unsigned int rowStride = ShadowmapBaker::resampleShadowHeights(
+                                 heightSnapshot->values.data(), heightSnapshot->resolution,
+                                 lightmapSize, heights);
+    ShadowmapBaker::generateShadowmap(shadowBakeMethod, lightDir, lightmap,
+                                      lightmapSize, heights, rowStride, nullptr);
 }
 
 void Terrain::createTerrain(const int heightmapSize,
@@ -385,8 +284,11 @@ void Terrain::createTerrain(const int heightmapSize,
        && sampleSquare == meshSampleSquare
        && terrainSeed == seed) return;
 
-    if(this->bakingThread.joinable()) this->bakingThread.join();
-
+    // bakes of the previous terrain are stale now
+    lightmapJob.cancel();
+    horizonJob.cancel();
+    occlusionJob.cancel();
+    bakedSlices.clear();
     // terrain unique seed
     this->terrainSeed = seed;
     this->heightmap.setSeed(seed);
@@ -397,22 +299,97 @@ void Terrain::createTerrain(const int heightmapSize,
     heightmap.setBounds(sampleSquare.x, sampleSquare.z,
                         sampleSquare.y, sampleSquare.z);
     heightmap.build();
+    heightmapChanged();
+}
+
+void Terrain::heightmapChanged(const TerrainSnapshot * stored)
+{
+    // jobs read this copy, never the heightmap itself
+    std::shared_ptr<HeightSnapshot> snapshot = std::make_shared<HeightSnapshot>();
+    snapshot->resolution = terrainResolution;
+    snapshot->values.resize(terrainResolution * terrainResolution);
+    // the clamped copy and its hash, the mesh heights and their normals
+    // and the texture upload don't depend on each other, the gl thread
+    // only uploads
+    JobSystem::JobHandle copyJob = JobSystem::run([&]()
+    {
+        Parallel::forEach(0, terrainResolution, [&](int y)
+        {
+            for(int x = 0; x < terrainResolution; x++)
+            {
+                snapshot->values[y * terrainResolution + x] =
+                    clamp(heightmap.getValue(x, y), 0.0, 1.0);
+            }
+        });
+    });
+    JobSystem::JobHandle hashJob;
+    JobSystem::JobHandle normalsJob;
+    std::vector<short> normals;
+    const short * normalMap;
+    const void * heightTexels;
+    meshHeights.resize(terrainResolution * terrainResolution);
+
+    if(stored)
+    {
+        // everything else was derived when the snapshot was written
+        const float * storedHeights = (const float *)stored->SectionData(
+                                          TerrainSnapshot::MeshHeights);
+        snapshot->hash = stored->Info().heightHash;
+        meshHeights.assign(storedHeights, storedHeights + meshHeights.size());
+        normalMap = (const short *)stored->SectionData(TerrainSnapshot::NormalMap);
+        heightTexels = stored->SectionData(TerrainSnapshot::HeightTexels);
+    }
+    else
+    {
+        hashJob = JobSystem::then(copyJob, [&]()
+        {
+            snapshot->hash = BakeCache::hash(snapshot->values.data(),
+                                             snapshot->values.size() * sizeof(float));
+        });
+        // filtered the way createMesh places its vertices, then the
+        // normal map from them
+        JobSystem::JobHandle meshHeightsJob = JobSystem::run([&]()
+        {
+            Parallel::forEach(0, terrainResolution, [&](int y)
+            {
+                for(int x = 0; x < terrainResolution; x++)
+                {
+                    meshHeights[y * terrainResolution + x] =
+                        TerrainMeshBuilder::vertexHeight(heightmap, x, y);
+                }
+            });
+        });
+        normalsJob = JobSystem::then(meshHeightsJob, [&]()
+        {
+            TerrainMapBaker::bakeNormalMap(meshHeights.data(), terrainResolution, normals);
+        });
+        normalMap = nullptr;
+        heightTexels = heightmap.RawImage();
+    }
+
     // create heightmap texture
     gl.Bound(Texture::Target::_2D, this->heightmapField)
     // we only need the intensity
     .Image2D(0, PixelDataInternalFormat::R8
              , terrainResolution, terrainResolution, 0,
              PixelDataFormat::RGBA, PixelDataType::UnsignedByte,
-             heightmap.RawImage())
+             heightTexels)
     .MinFilter(TextureMinFilter::Linear)
     .MagFilter(TextureMagFilter::Linear)
     .WrapS(TextureWrap::Repeat)
     .WrapT(TextureWrap::Repeat);
+    JobSystem::wait(copyJob);
+    JobSystem::wait(hashJob);
+    JobSystem::wait(normalsJob);
+    this->heightSnapshot = snapshot;
     heightmapCreated = true;
     meshCreated = false;
-    program.Use();
-    Uniform<glm::vec2>(program, "terrainMapSize")
-    .Set(glm::vec2(terrainResolution, terrainResolution));
+    // shading detail independent from the mesh resolution
+    createNormalMap(normalMap ? normalMap : normals.data());
+    splatMapDirty = true;
+    // sun direction independent, bake it once per terrain
+    generateHorizonMap();
+    generateOcclusionMap();
 }
 
 void Terrain::createMesh(const int meshResExponent)
@@ -420,152 +397,41 @@ void Terrain::createMesh(const int meshResExponent)
     // will not create a mesh until height data is ready
     if(!heightmapCreated) return;
 
-    this->meshResolution = (int)std::pow(2, meshResExponent) + 1;
     // mesh data collections
     std::vector<glm::vec3> vertices;
     std::vector<glm::vec2> texCoords;
     std::vector<glm::vec3> normals;
     std::vector<unsigned int> indices;
-    // reserve space for new data
-    vertices.resize(meshResolution * meshResolution);
-    normals.resize(meshResolution * meshResolution);
-    texCoords.resize(meshResolution * meshResolution);
-    indices.resize((meshResolution - 1) * meshResolution * 2 + meshResolution);
-    // load mesh positions and heights as vertices
-    float textureU = (float)meshResolution * 0.1f;
-    float textureV = (float)meshResolution * 0.1f;
-    // index buffer restart triangle strip
-    int restartIndex = meshResolution * meshResolution;
-    // parallel modification
-    concurrency::parallel_for(int(0), meshResolution, [&](int i)
-    {
-        int indexAt = i * (2 * meshResolution + 1);
-
-        for(int j = 0; j < meshResolution; j++)
-        {
-            // scales to x, z [0.0, 1.0]
-            float colScale = (float)j / (meshResolution - 1);
-            float rowScale = (float)i / (meshResolution - 1);
-            // height map positions
-            int xCor = (int)(j * (float)terrainResolution / meshResolution);
-            int yCor = (int)(i * (float)terrainResolution / meshResolution);
-            float samplesSum = 0.0;
-            int samplesWeight = 0;
-
-            // get vertex height from heightmap data
-            for(int x = -1; x <= 1; x++)
-            {
-                for(int y = -1; y <= 1; y++)
-                {
-                    if(x + xCor >= 0
-                       && x + xCor <= terrainResolution - 1
-                       && y + yCor >= 0
-                       && y + yCor <= terrainResolution - 1)
-                    {
-                        samplesWeight++;
-                        samplesSum += heightmap.getValue(x + xCor, y + yCor);
-                    }
-                }
-            }
-
-            float vertexHeight = samplesSum / samplesWeight;
-            // transform from [-1,1] to [0,1]
-            vertexHeight = clamp((vertexHeight + 1.0f) / 2.0f, 0.0f, 1.0f);
-            // create vertex position
-            vertices[i * meshResolution + j] =
-                glm::vec3(
-                    -0.5f + colScale,
-                    vertexHeight,
-                    -0.5f + rowScale
-                );
-            // also create the appropiate texcoord
-            texCoords[i * meshResolution + j] =
-                glm::vec2(
-                    colScale,
-                    rowScale
-                );
-
-            // create triangle strip indices
-            if(i != meshResolution - 1)
-            {
-                indices[j * 2 + indexAt] = ((i + 1) * meshResolution + j);
-                indices[(j + 1) * 2 - 1 + indexAt] = (i * meshResolution + j);
-            }
-        }
-
-        // indices restart token
-        if(i != meshResolution - 1)
-        {
-            int restartAt = 2 * (i + 1) * meshResolution + i;
-            indices[restartAt] = restartIndex;
-        }
-    });
-    //// calculate face normals
-    std::array<std::vector<std::vector<glm::vec3>>, 2> faceNormals;
-    faceNormals[0] = faceNormals[1] = std::vector<std::vector<glm::vec3>>
-                                      (meshResolution - 1, std::vector<glm::vec3>(meshResolution - 1));
-    concurrency::parallel_for(int(0), meshResolution - 1, [&](int i)
-    {
-        for(int j = 0; j < meshResolution - 1; j++)
-        {
-            glm::vec3 triangle0[] =
-            {
-                vertices[i * meshResolution + j],
-                vertices[(i + 1) * meshResolution + j],
-                vertices[(i + 1) * meshResolution + j + 1]
-            };
-            glm::vec3 triangle1[] =
-            {
-                vertices[(i + 1) * meshResolution + j + 1],
-                vertices[i * meshResolution + j + 1],
-                vertices[i * meshResolution + j]
-            };
-            glm::vec3 t0Normal = glm::cross(triangle0[0] - triangle0[1],
-                                            triangle0[1] - triangle0[2]);
-            glm::vec3 t1Normal = glm::cross(triangle1[0] - triangle1[1],
-                                            triangle1[1] - triangle1[2]);
-            faceNormals[0][i][j] = glm::normalize(t0Normal);
-            faceNormals[1][i][j] = glm::normalize(t1Normal);
-        }
-    });
-    concurrency::parallel_for(int(0), meshResolution - 1, [&](int i)
-    {
-        for(int j = 0; j < meshResolution; j++)
-        {
-            glm::vec3 fNormal = glm::vec3(0.f, 0.f, 0.f);
-
-            // upper left faces
-            if(j != 0 && i != 0)
-            {
-                fNormal += faceNormals[0][i - 1][j - 1] + faceNormals[1][i - 1][j - 1];
-            }
-
-            // upper right faces
-            if(i != 0 && j != meshResolution - 1)
-            {
-                fNormal += faceNormals[0][i - 1][j];
-            }
-
-            // bottom right faces
-            if(i != meshResolution - 1 && j != meshResolution - 1)
-            {
-                fNormal += faceNormals[0][i][j] + faceNormals[1][i][j];
-            }
-
-            // bottom left faces
-            if(i != meshResolution - 1 && j != 0)
-            {
-                fNormal += faceNormals[1][i][j - 1];
-            }
+    this->meshResolution = (1 << meshResExponent) + 1;
+    TerrainMeshBuilder::buildMesh(heightmap, meshResExponent, vertices, normals,
+                                  texCoords, indices);
+    uploadMesh(vertices.data(), normals.data(), texCoords.data(),
+               indices.data(), indices.size());
+    // generate mesh chunk process
+    this->chunkGenerator.generateChunks(
+        vertices, normals, texCoords, meshResExponent,
+        TerrainMeshBuilder::ChunkSizeExponent
+    );
+    // mesh finally done
+    meshCreated = true;
+    // clear vector collections once uploaded
+    vertices.clear();
+    normals.clear();
+    texCoords.clear();
+    indices.clear();
+}
 
-            normals[i * meshResolution + j] = glm::normalize(fNormal);
-        }
-    });
+void Terrain::uploadMesh(const glm::vec3 * vertices, const glm::vec3 * normals,
+                         const glm::vec2 * texCoords, const unsigned int * indices,
+                         size_t indexCount)
+{
+    const size_t vertexCount = meshResolution * meshResolution;
     // upload position data to the gpu
     buffer[0].Bind(Buffer::Target::Array);
     {
         GLuint nPerVertex = glm::vec3().length();
-        Buffer::Data(Buffer::Target::Array, vertices);
+        Buffer::Data(Buffer::Target::Array, (GLsizei)vertexCount * 3,
+                     (const GLfloat *)vertices);
         // setup the vertex attribs array for the vertices
         (program | 0).Setup<GLfloat>(nPerVertex).Enable();
     }
@@ -573,7 +439,8 @@ void Terrain::createMesh(const int meshResExponent)
     {
         GLuint nPerVertex = glm::vec3().length();
         // upload the data
-        Buffer::Data(Buffer::Target::Array, normals);
+        Buffer::Data(Buffer::Target::Array, (GLsizei)vertexCount * 3,
+                     (const GLfloat *)normals);
         // setup the vertex attribs array for the vertices
         (program | 1).Setup<GLfloat>(nPerVertex).Enable();
     }
@@ -581,29 +448,18 @@ void Terrain::createMesh(const int meshResExponent)
     {
         GLuint nPerVertex = glm::vec2().length();
         // upload the data
-        Buffer::Data(Buffer::Target::Array, texCoords);
+        Buffer::Data(Buffer::Target::Array, (GLsizei)vertexCount * 2,
+                     (const GLfloat *)texCoords);
         // setup the vertex attribs array for the vertices
         (program | 2).Setup<GLfloat>(nPerVertex).Enable();
     }
     buffer[3].Bind(Buffer::Target::ElementArray);
     {
-        Buffer::Data(Buffer::Target::ElementArray, indices);
+        Buffer::Data(Buffer::Target::ElementArray, (GLsizei)indexCount, indices);
         gl.Enable(Capability::PrimitiveRestart);
-        gl.PrimitiveRestartIndex(restartIndex);
+        gl.PrimitiveRestartIndex(meshResolution * meshResolution);
     }
-    this->indexSize = indices.size();
-    // generate mesh chunk process
-    this->chunkGenerator.generateChunks(
-        vertices, normals, texCoords, meshResExponent, 4
-    );
-    this->chunkGenerator.bindBufferData(this->program);
-    // mesh finally done
-    meshCreated = true;
-    // clear vector collections once uploaded
-    vertices.clear();
-    normals.clear();
-    texCoords.clear();
-    indices.clear();
+    this->indexSize = indexCount;
 }
 
 void Terrain::bakeLightmaps(float freq, int lightmapSize)
@@ -613,44 +469,64 @@ void Terrain::bakeLightmaps(float freq, int lightmapSize)
        || lightmapSize < 4
       ) return;
 
-    this->lightmapsFrequency = (int)std::ceil(freq);
+    // bc4 works on 4x4 blocks
+    lightmapSize = (lightmapSize + LightmapCompression::BlockSize - 1)
+                   / LightmapCompression::BlockSize * LightmapCompression::BlockSize;
 
-    // end early the current working thread
-    if(this->bakingThread.joinable())
+    // end early the current job, its lightmaps are stale now
+    lightmapJob.cancel();
+    bakedSlices.clear();
+    this->lightmapsFrequency = (int)std::ceil(freq);
+    this->lightmapResolution = lightmapSize;
+    std::shared_ptr<const HeightSnapshot> snapshot = heightSnapshot;
+    ShadowmapBaker::Method method = shadowBakeMethod;
+    int sliceCount = lightmapsFrequency;
+    std::uint64_t cacheKey = lightmapCacheKey(*snapshot, method, sliceCount,
+                             lightmapSize);
+    // already baked once, upload straight from the mapped file
+    MappedFile cacheFile;
+    const unsigned char * cachedTexels = nullptr;
+
+    if(BakeCache::load(cacheKey, BakeCache::TimeOfTheDayLightmaps, lightmapSize,
+                       lightmapSize, sliceCount,
+                       LightmapCompression::blocksSize(lightmapSize) * sliceCount,
+                       cacheFile, cachedTexels))
     {
-        this->earlyExit = true;
-        this->bakingThread.join();
+        createTOTDTexture(cachedTexels);
+        BOOST_LOG_TRIVIAL(info) << "Baking Info: " << sliceCount
+                                << " lightmaps loaded from cache";
+        return;
     }
 
-    // no need for early exit anymore
-    this->earlyExit = false;
+    // empty texture, slices are uploaded as they are baked
+    createTOTDTexture(nullptr);
+    // the slice seen right now is baked first
+    float dayTime = std::fmod(currentTime, glm::two_pi<float>());
 
-    // create 3d texture with existing data
-    // will only happend if thread finished successfully
-    if(bakingDone) createTOTD3DTexture();
+    if(dayTime < 0.0f) dayTime += glm::two_pi<float>();
 
-    this->lightmapResolution = lightmapSize;
-    // reserve memory in main thread for new lightmap data
-    terrainLightmapsData = new unsigned char[
-        lightmapSize * lightmapSize * lightmapsFrequency
-    ];
+    int firstSlice = (int)(dayTime / glm::two_pi<float>() * lightmapsFrequency)
+                     % lightmapsFrequency;
     // bake all the lightmaps in a separate thread so it doesn't freeze the main thread
-    this->bakingThread = std::thread(
-                             &Terrain::bakeTimeOfTheDayShadowmap, this, lightmapSize
-                         );
+    lightmapJob.start(sliceCount, [ = ](BakingJob & job)
+    {
+        bakeTimeOfTheDayShadowmap(job, snapshot, method, sliceCount, lightmapSize,
+                                  firstSlice, cacheKey);
+    });
 }
 
 void Terrain::setTextureRepeatFrequency(const glm::vec2 &value)
 {
     program.Use();
-    Uniform<glm::vec2>(program, "terrainUVScaling")
-    .Set(value);
+    terrainUVScaling.Set(value);
 }
 
 void Terrain::setTextureRange(const int index, const float start,
                               const float end)
 {
     this->terrainTextures.SetTextureRange(index, start, end);
+    // rebaked once before the next frame
+    splatMapDirty = true;
 }
 
 void Terrain::loadTexture(const int index, const std::string &filepath)
@@ -676,6 +552,8 @@ void Terrain::HeightScale(float val)
             )
         )
     );
+    // occlusion angles change with the terrain proportions
+    generateOcclusionMap();
 }
 
 void Terrain::TerrainHorizontalScale(float val)
@@ -691,6 +569,8 @@ void Terrain::TerrainHorizontalScale(float val)
             )
         )
     );
+    // occlusion angles change with the terrain proportions
+    generateOcclusionMap();
 }
 
 void Terrain::saveTerrainToFile(const std::string &filename)
@@ -698,49 +578,181 @@ void Terrain::saveTerrainToFile(const std::string &filename)
     this->heightmap.writeToFile(filename);
 }
 
+bool Terrain::saveSnapshot(const std::string &filename)
+{
+    if(!meshCreated) return false;
+
+    TerrainSnapshot::Description description;
+    description.terrainResolution = terrainResolution;
+    description.meshSizeExponent = chunkGenerator.MeshSizeExponent();
+    description.chunkSizeExponent = chunkGenerator.ChunkSizeExponent();
+    description.seed = terrainSeed;
+    description.sampleSquare[0] = meshSampleSquare.x;
+    description.sampleSquare[1] = meshSampleSquare.y;
+    description.sampleSquare[2] = meshSampleSquare.z;
+    description.lightmapSize = 0;
+    description.lightmapSlices = 0;
+    description.heightHash = heightSnapshot->hash;
+    // raw heightmap values, the rest of the height data derives from them
+    std::vector<float> heights(terrainResolution * terrainResolution);
+    Parallel::forEach(0, terrainResolution, [&](int y)
+    {
+        for(int x = 0; x < terrainResolution; x++)
+        {
+            heights[y * terrainResolution + x] = heightmap.getValue(x, y);
+        }
+    });
+    // the gpu buffers keep no cpu copy, the mesh is built again
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<unsigned int> indices;
+    TerrainMeshBuilder::buildMesh(heightmap, description.meshSizeExponent, vertices,
+                                  normals, texCoords, indices);
+    std::vector<glm::vec3> chunkVertices;
+    std::vector<glm::vec3> chunkNormals;
+    std::vector<glm::vec2> chunkTexCoords;
+    TerrainMeshBuilder::buildChunkVertices(vertices, normals, texCoords,
+                                           description.meshSizeExponent,
+                                           description.chunkSizeExponent,
+                                           chunkVertices, chunkNormals, chunkTexCoords);
+    // nor the normal map texture, loading uploads it as it is
+    std::vector<short> normalMap;
+    TerrainMapBaker::bakeNormalMap(meshHeights.data(), terrainResolution, normalMap);
+    std::vector<TerrainSnapshot::ChunkBounds> chunkBounds;
+    chunkGenerator.getChunkBounds(chunkBounds);
+    std::array<std::vector<unsigned int>, 3> lodIndices;
+    TerrainMeshBuilder::buildLoDIndices(meshResolution,
+                                        (1 << description.chunkSizeExponent) + 1, lodIndices);
+    // lightmaps are stored only once every slice is baked
+    std::vector<unsigned char> lightmapBlocks;
+
+    if(validSliceCount == lightmapsFrequency && lightmapsFrequency > 0)
+    {
+        description.lightmapSize = lightmapResolution;
+        description.lightmapSlices = lightmapsFrequency;
+        lightmapBlocks.resize(TerrainSnapshot::sectionSize(description,
+                              TerrainSnapshot::Lightmaps));
+        Texture::Active(2);
+        gl.Bind(Texture::Target::_2DArray, this->terrainTOTDLightmap);
+        glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, 0, lightmapBlocks.data());
+        Texture::Active(0);
+    }
+
+    const void * sections[TerrainSnapshot::SectionCount] =
+    {
+        heights.data(), heightmap.RawImage(), meshHeights.data(),
+        normalMap.data(), vertices.data(), normals.data(), texCoords.data(),
+        indices.data(), chunkVertices.data(), chunkNormals.data(),
+        chunkTexCoords.data(), chunkBounds.data(), lodIndices[0].data(),
+        lodIndices[1].data(), lodIndices[2].data(), lightmapBlocks.data()
+    };
+
+    if(!TerrainSnapshot::write(filename, description, sections)) return false;
+
+    BOOST_LOG_TRIVIAL(info) << "Snapshot Info: terrain saved to " << filename;
+    return true;
+}
+
+bool Terrain::loadSnapshot(const std::string &filename)
+{
+    TerrainSnapshot snapshot;
+
+    if(!snapshot.open(filename))
+    {
+        BOOST_LOG_TRIVIAL(error) << "Snapshot Error: " << filename
+                                 << " is missing or not a valid snapshot";
+        return false;
+    }
+
+    const TerrainSnapshot::Description &description = snapshot.Info();
+    // bakes of the previous terrain are stale now
+    lightmapJob.cancel();
+    horizonJob.cancel();
+    occlusionJob.cancel();
+    bakedSlices.clear();
+    // same state createTerrain leaves, without building the heightmap
+    this->terrainSeed = description.seed;
+    this->heightmap.setSeed(description.seed);
+    this->terrainResolution = description.terrainResolution;
+    this->meshSampleSquare = glm::vec3(description.sampleSquare[0],
+                                       description.sampleSquare[1], description.sampleSquare[2]);
+    heightmap.setBounds(meshSampleSquare.x, meshSampleSquare.z,
+                        meshSampleSquare.y, meshSampleSquare.z);
+    heightmap.load((const float *)snapshot.SectionData(TerrainSnapshot::Heights),
+                   terrainResolution, terrainResolution);
+    heightmapChanged(&snapshot);
+    // mesh buffers straight from the mapping
+    this->meshResolution = (1 << description.meshSizeExponent) + 1;
+    uploadMesh(
+        (const glm::vec3 *)snapshot.SectionData(TerrainSnapshot::MeshVertices),
+        (const glm::vec3 *)snapshot.SectionData(TerrainSnapshot::MeshNormals),
+        (const glm::vec2 *)snapshot.SectionData(TerrainSnapshot::MeshTexCoords),
+        (const unsigned int *)snapshot.SectionData(TerrainSnapshot::MeshIndices),
+        snapshot.SectionSize(TerrainSnapshot::MeshIndices) / sizeof(unsigned int)
+    );
+    this->chunkGenerator.loadChunks(snapshot);
+    meshCreated = true;
+
+    if(description.lightmapSlices > 0)
+    {
+        this->lightmapsFrequency = description.lightmapSlices;
+        this->lightmapResolution = description.lightmapSize;
+        createTOTDTexture(snapshot.SectionData(TerrainSnapshot::Lightmaps));
+    }
+    else
+    {
+        // the previous terrain shadows must not show, unshadowed until
+        // baked from the interface
+        lightmapJob.cancel();
+        bakedSlices.clear();
+        validSliceFirst = 0;
+        validSliceCount = 0;
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Snapshot Info: terrain loaded from " << filename;
+    return true;
+}
+
 Terrain::Terrain() : heightScale(2.0f), heightmapCreated(false),
-    meshCreated(false), timeScale(0.1f)
+    meshCreated(false), timeScale(0.1f), currentTime(0.0f), validSliceFirst(0),
+    validSliceCount(0), horizonMapResolution(0), occlusionMapResolution(0),
+    splatMapDirty(false)
 {
     this->lightmapsFrequency = 12;
+    this->lightmapResolution = 256;
 }
 
 void Terrain::initialize()
 {
-    vertexShader.Source(GLSLSource::FromFile("Resources/Shaders/terrain.vert"));
-    // compile it
-    vertexShader.Compile();
-    // set the fragment shader source
-    fragmentShader.Source(GLSLSource::FromFile("Resources/Shaders/terrain.frag"));
-    // compile it
-    fragmentShader.Compile();
-    // attach the shaders to the program
-    program.AttachShader(vertexShader);
-    program.AttachShader(fragmentShader);
-    // link and use it
-    program.Link();
+    // link from the previous run binary or compile the sources
+    ProgramCache::link(program,
+                       ProgramCache::loadSource("Resources/Shaders/terrain.vert"),
+                       ProgramCache::loadSource("Resources/Shaders/terrain.frag"));
+    program.Use();
+    // bound uniforms set outside initialize
+    this->terrainUVScaling.Assign(program);
+    this->occlusionStrength.Assign(program);
+    this->terrainUVScaling.BindTo("terrainUVScaling");
+    this->occlusionStrength.BindTo("occlusionStrength");
+    // depth pre-pass program
+    ProgramCache::link(depthProgram,
+                       ProgramCache::loadSource("Resources/Shaders/depth.vert"),
+                       ProgramCache::loadSource("Resources/Shaders/depth.frag"));
+    // per frame values, both programs read the same uniform buffer
+    glUniformBlockBinding(GetGLName(program),
+                          glGetUniformBlockIndex(GetGLName(program), "FrameUniforms"),
+                          FrameUniformsBinding);
+    glUniformBlockBinding(GetGLName(depthProgram),
+                          glGetUniformBlockIndex(GetGLName(depthProgram), "FrameUniforms"),
+                          FrameUniformsBinding);
+    frameUniformBuffer.Bind(Buffer::Target::Uniform);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr,
+                 GL_STREAM_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FrameUniformsBinding,
+                     GetGLName(frameUniformBuffer));
     program.Use();
-    // bound commonly used uniforms
-    this->lightDirection.Assign(program);
-    this->lightIntensities.Assign(program);
-    this->currentLightmap.Assign(program);
-    this->modelViewProjection.Assign(program);
-    this->modelView.Assign(program);
-    this->normalMatrix.Assign(program);
-    // bound commonly used uniforms
-    this->lightDirection.BindTo("directionalLight.direction");
-    this->lightIntensities.BindTo("directionalLight.base.intensities");
-    this->currentLightmap.BindTo("currentLightmap");
-    this->modelViewProjection.BindTo("matrix.modelViewProjection");
-    this->normalMatrix.BindTo("matrix.normal");
-    this->modelView.BindTo("matrix.modelView");
     // set prog uniforms
-    Uniform<glm::vec3>(program, "directionalLight.base.intensities").Set(
-        // full sunlight
-        glm::vec3(1.0f, 1.0f, 0.86f)
-    );
-    Uniform<glm::vec3>(program, "directionalLight.direction").Set(
-        glm::vec3(0.5f, 1.7f, 0.7f)
-    );
     Uniform<GLfloat>(program, "lightParams.ambientCoefficient").Set(
         0.1f
     );
@@ -759,13 +771,31 @@ void Terrain::initialize()
     Uniform<GLfloat>(program, "material.shininessStrength").Set(
         0.0375
     );
-    Uniform<glm::vec2>(program, "terrainUVScaling").Set(
-        glm::vec2(25, 25)
+    terrainUVScaling.Set(glm::vec2(25, 25));
+    Uniform<GLint>(program, "horizonMap").Set(
+        1
+    );
+    Uniform<GLint>(program, "bakedLightmaps").Set(
+        2
+    );
+    Uniform<GLint>(program, "ambientOcclusionMap").Set(
+        3
+    );
+    Uniform<GLint>(program, "normalMap").Set(
+        4
+    );
+    Uniform<GLint>(program, "splatMap").Set(
+        5
     );
+    // unoccluded until the first ambient occlusion bake is done
+    const unsigned char openSky = 255;
+    createOcclusionTexture(&openSky, 1);
     TransformationMatrices::Model(
         glm::scale(glm::mat4(), glm::vec3(15, heightScale, 15))
     );
     terrainMesh.Bind();
+    // gpu timer queries
+    governor.initialize();
     // context flags
     gl.Enable(Capability::DepthTest);
     gl.Enable(Capability::CullFace);
@@ -776,77 +806,356 @@ void Terrain::initialize()
     this->TerrainHorizontalScale(15.f);
 }
 
-void Terrain::bakeTimeOfTheDayShadowmap(int lightmapSize)
+void Terrain::bakeTimeOfTheDayShadowmap(BakingJob &job,
+                                        std::shared_ptr<const HeightSnapshot> snapshot,
+                                        ShadowmapBaker::Method method, int sliceCount,
+                                        int lightmapSize, int firstSlice,
+                                        std::uint64_t cacheKey)
 {
-    if(!heightmapCreated) return;
-
-    this->bakingInProgress = true;
-    float sizeFreq = (float)this->lightmapsFrequency;
+    float sizeFreq = (float)sliceCount;
+    const size_t blocksSize = LightmapCompression::blocksSize(lightmapSize);
+    // every slice is kept compressed for the bake cache
+    std::vector<unsigned char> allBlocks(blocksSize * sliceCount);
+    // every lightmap marches over the same heights
+    std::vector<float> heights;
+    unsigned int rowStride = ShadowmapBaker::resampleShadowHeights(
+                                 snapshot->values.data(), snapshot->resolution, lightmapSize,
+                                 heights);
 
     for(int i = 0; i < sizeFreq; i++)
     {
-        if(earlyExit) return;
+        if(job.CancelRequested()) return;
 
+        // firstSlice, firstSlice + 1, firstSlice - 1, firstSlice + 2...
+        int offset = (i + 1) / 2 * (i % 2 ? 1 : -1);
+        int slice = ((firstSlice + offset) % sliceCount + sliceCount) % sliceCount;
         std::vector<unsigned char> bakedLightmap;
-        this->fastGenerateShadowmapParallel(
-            calculateLightDir(2.0f * glm::pi<float>() * (float)(i + 1) / sizeFreq),
-            bakedLightmap, lightmapSize
-        );
-        std::copy(
-            bakedLightmap.begin(), bakedLightmap.end(),
-            &this->terrainLightmapsData[
-                i * lightmapSize * lightmapSize
-            ]
+        ShadowmapBaker::generateShadowmap(
+            method,
+            calculateLightDir(ShadowmapBaker::sliceTime(slice, sliceCount)),
+            bakedLightmap, lightmapSize, heights, rowStride, &job
         );
+
+        // partially baked, don't publish it
+        if(job.CancelRequested()) return;
+
+        unsigned char * sliceBlocks = allBlocks.data() + slice * blocksSize;
+        LightmapCompression::encodeBC4(bakedLightmap, lightmapSize, sliceBlocks);
+        std::vector<unsigned char> blocks(sliceBlocks, sliceBlocks + blocksSize);
+        {
+            // main thread uploads it on the next frame
+            std::lock_guard<std::mutex> lock(bakedSlicesMutex);
+            bakedSlices.push_back(std::make_pair(slice, std::move(blocks)));
+        }
+        job.advance();
         // print baking progress
         BOOST_LOG_TRIVIAL(info) << "Baking Info: Lightmap "
                                 << i + 1 << "/"
-                                << lightmapsFrequency
+                                << sliceCount
                                 << " ("
-                                << (int)(100 * (float)(i + 1) / (lightmapsFrequency))
+                                << (int)(100 * job.Progress())
                                 << "%) created";
-        bakedLightmap.clear();
     };
 
-    this->bakingDone = true;
+    BakeCache::store(cacheKey, BakeCache::TimeOfTheDayLightmaps, lightmapSize,
+                     lightmapSize, sliceCount, allBlocks.data(), allBlocks.size());
+}
+
+std::uint64_t Terrain::lightmapCacheKey(const HeightSnapshot &snapshot,
+                                        ShadowmapBaker::Method method, int sliceCount, int lightmapSize) const
+{
+    // light path parameters decide every baked sun direction
+    const float lightPath[] = { sunTime, sunAltitude, moonAltitude };
+    const int layout[] = { BakeCache::TimeOfTheDayLightmaps, method, sliceCount, lightmapSize };
+    std::uint64_t key = BakeCache::hash(lightPath, sizeof(lightPath), snapshot.hash);
+    return BakeCache::hash(layout, sizeof(layout), key);
+}
+
+std::uint64_t Terrain::horizonCacheKey(const HeightSnapshot &snapshot) const
+{
+    const int layout[] = { BakeCache::HorizonMap, HorizonSectors, snapshot.resolution };
+    return BakeCache::hash(layout, sizeof(layout), snapshot.hash);
 }
 
-void Terrain::createTOTD3DTexture()
+void Terrain::createTOTDTexture(const unsigned char * blocks)
 {
-    // pass data to interface texture
-    gl.Bound(Texture::Target::_3D, this->terrainTOTDLightmap)
+    // rgtc isn't allowed on 3d textures, the shader blends between layers
+    Texture::Active(2);
+    gl.Bound(Texture::Target::_2DArray, this->terrainTOTDLightmap)
     .MinFilter(TextureMinFilter::Linear)
     .MagFilter(TextureMagFilter::Linear)
     .WrapS(TextureWrap::Repeat)
-    .WrapT(TextureWrap::Repeat)
-    .Image3D(0, PixelDataInternalFormat::R8, lightmapResolution,
-             lightmapResolution, this->lightmapsFrequency, 0,
-             PixelDataFormat::Red, PixelDataType::UnsignedByte, terrainLightmapsData);
+    .WrapT(TextureWrap::Repeat);
+    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_COMPRESSED_RED_RGTC1,
+                           lightmapResolution, lightmapResolution, lightmapsFrequency, 0,
+                           (GLsizei)(LightmapCompression::blocksSize(lightmapResolution)
+                                     * lightmapsFrequency), blocks);
+    Texture::Active(0);
+    validSliceFirst = 0;
+    validSliceCount = blocks ? lightmapsFrequency : 0;
+}
+
+void Terrain::uploadBakedLightmaps()
+{
+    // read before taking the slices, so every slice is in hand when done
+    bool finished = lightmapJob.State() == BakingJob::Finished;
+    std::deque<std::pair<int, std::vector<unsigned char>>> slices;
+    {
+        std::lock_guard<std::mutex> lock(bakedSlicesMutex);
+        slices.swap(bakedSlices);
+    }
+
+    if(!slices.empty())
+    {
+        Texture::Active(2);
+        gl.Bind(Texture::Target::_2DArray, this->terrainTOTDLightmap);
+    }
+
+    for(auto &baked : slices)
+    {
+        int slice = baked.first;
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slice,
+                                  lightmapResolution, lightmapResolution, 1,
+                                  GL_COMPRESSED_RED_RGTC1,
+                                  (GLsizei)baked.second.size(), baked.second.data());
+
+        // slices come ordered outwards, each one extends the valid range
+        if(validSliceCount == 0)
+        {
+            validSliceFirst = slice;
+            validSliceCount = 1;
+        }
+        else if(slice == (validSliceFirst + validSliceCount) % lightmapsFrequency)
+        {
+            validSliceCount++;
+        }
+        else if(slice == (validSliceFirst - 1 + lightmapsFrequency) % lightmapsFrequency)
+        {
+            validSliceFirst = slice;
+            validSliceCount++;
+        }
+    }
+
+    if(!slices.empty()) Texture::Active(0);
+
+    if(!finished || !lightmapJob.collect()) return;
+
     // print baking info
     BOOST_LOG_TRIVIAL(info) << "Baking Done, "
                             << this->lightmapsFrequency
                             << " lightmaps created, "
                             << (float)this->lightmapsFrequency / 24.0f
                             << " per hour";
-    // set new lightmap size to shader
-    Uniform<glm::vec2>(program, "lightmapSize")
-    .Set(glm::vec2(lightmapResolution, lightmapResolution));
-    // delete temporal raw data once uploaded to gpu
-    delete[]terrainLightmapsData;
-    // baking flags for done upload
-    bakingDone = false;
-    bakingInProgress = false;
 }
 
-Terrain::~Terrain()
+void Terrain::generateHorizonMap()
 {
-    if(this->bakingThread.joinable())
+    if(!heightmapCreated) return;
+
+    std::shared_ptr<const HeightSnapshot> snapshot = heightSnapshot;
+    std::uint64_t cacheKey = horizonCacheKey(*snapshot);
+    MappedFile cacheFile;
+    const unsigned char * cachedTexels = nullptr;
+    horizonJob.cancel();
+
+    if(BakeCache::load(cacheKey, BakeCache::HorizonMap, snapshot->resolution,
+                       snapshot->resolution, HorizonSectors / 4,
+                       snapshot->resolution * snapshot->resolution * HorizonSectors,
+                       cacheFile, cachedTexels))
+    {
+        createHorizonTexture(cachedTexels, snapshot->resolution);
+        return;
+    }
+
+    // starting a job ends early the current one
+    horizonJob.start(terrainResolution, [ = ](BakingJob & job)
     {
-        this->earlyExit = true;
-        this->bakingThread.join();
+        bakeHorizonMap(job, snapshot, cacheKey);
+    });
+}
 
-        if(bakingDone) delete[]terrainLightmapsData;
-    };
+void Terrain::bakeHorizonMap(BakingJob &job,
+                             std::shared_ptr<const HeightSnapshot> snapshot,
+                             std::uint64_t cacheKey)
+{
+    const int resolution = snapshot->resolution;
+    std::vector<float> heights;
+    unsigned int rowStride = ShadowmapBaker::resampleShadowHeights(
+                                 snapshot->values.data(), resolution, resolution, heights);
+    const float * heightData = heights.data();
+    const int layerSize = resolution * resolution * 4;
+    std::vector<unsigned char> horizons(layerSize * HorizonSectors / 4);
+    // sector march directions on the lightmap plane
+    std::array<glm::vec2, HorizonSectors> sectorDirection;
+
+    for(int k = 0; k < HorizonSectors; k++)
+    {
+        float azimuth = 2.0f * glm::pi<float>() * k / HorizonSectors;
+        sectorDirection[k] = glm::vec2(std::cos(azimuth), std::sin(azimuth));
+    }
+
+    const float maxHeight = 255.0f;
+    const float border = resolution - 1.0f;
+    Parallel::forEach(0, resolution, [&](int y)
+    {
+        if(job.CancelRequested()) return;
+
+        for(int x = 0; x < resolution; x++)
+        {
+            float originHeight = heightData[y * rowStride + x];
+
+            for(int k = 0; k < HorizonSectors; k++)
+            {
+                float maxSlope = 0.0f;
+                float distance = 1.0f;
+
+                // farther samples can't rise above the current horizon
+                while(distance * maxSlope < maxHeight - originHeight)
+                {
+                    float px = x + sectorDirection[k].x * distance;
+                    float py = y + sectorDirection[k].y * distance;
+
+                    if(px < 0 || px >= border || py < 0 || py >= border) break;
+
+                    int x0 = int(px);
+                    int y0 = int(py);
+                    float du = px - x0;
+                    float dv = py - y0;
+                    const float * row0 = heightData + y0 * rowStride;
+                    const float * row1 = row0 + rowStride;
+                    float height = glm::mix(
+                                       glm::mix(row0[x0], row0[x0 + 1], du),
+                                       glm::mix(row1[x0], row1[x0 + 1], du), dv
+                                   );
+                    maxSlope = std::max(maxSlope, (height - originHeight) / distance);
+                    // far away a texel barely changes the angle, step coarser
+                    distance += std::max(1.0f, distance / 32.0f);
+                }
+
+                float elevation = std::atan(maxSlope) / glm::half_pi<float>();
+                horizons[(k / 4) * layerSize + (y * resolution + x) * 4 + k % 4] =
+                    (unsigned char)(elevation * 255.0f + 0.5f);
+            }
+        }
+
+        job.advance();
+    });
+
+    if(job.CancelRequested()) return;
+
+    BakeCache::store(cacheKey, BakeCache::HorizonMap, resolution, resolution,
+                     HorizonSectors / 4, horizons.data(), horizons.size());
+    this->horizonMapData.swap(horizons);
+    this->horizonMapResolution = resolution;
+}
+
+void Terrain::createHorizonTexture(const unsigned char * texels,
+                                   int resolution)
+{
+    // keep the horizon map on its own unit, unit 0 targets are all taken
+    Texture::Active(1);
+    gl.Bound(Texture::Target::_2DArray, this->terrainHorizonMap)
+    .MinFilter(TextureMinFilter::Linear)
+    .MagFilter(TextureMagFilter::Linear)
+    .WrapS(TextureWrap::ClampToEdge)
+    .WrapT(TextureWrap::ClampToEdge)
+    .Image3D(0, PixelDataInternalFormat::RGBA8, resolution, resolution,
+             HorizonSectors / 4, 0,
+             PixelDataFormat::RGBA, PixelDataType::UnsignedByte, texels);
+    Texture::Active(0);
+    BOOST_LOG_TRIVIAL(info) << "Baking Done, horizon map with "
+                            << HorizonSectors << " sectors created";
+}
+
+void Terrain::createNormalMap(const short * normals)
+{
+    Texture::Active(4);
+    gl.Bound(Texture::Target::_2D, this->terrainNormalMap)
+    .MinFilter(TextureMinFilter::Linear)
+    .MagFilter(TextureMagFilter::Linear)
+    .WrapS(TextureWrap::ClampToEdge)
+    .WrapT(TextureWrap::ClampToEdge)
+    .Image2D(0, PixelDataInternalFormat::RG16SNorm, terrainResolution,
+             terrainResolution, 0, PixelDataFormat::RG, PixelDataType::Short,
+             normals);
+    Texture::Active(0);
+}
+
+void Terrain::createSplatMap()
+{
+    const int rangeCount = TerrainMultiTexture::MAX_TERRAIN_TEXTURE_RANGES;
+    std::vector<unsigned char> weights;
+    TerrainMapBaker::bakeSplatMap(meshHeights.data(), terrainResolution,
+                                  terrainTextures.Ranges(), rangeCount, weights);
+    Texture::Active(5);
+    gl.Bound(Texture::Target::_2DArray, this->terrainSplatMap)
+    .MinFilter(TextureMinFilter::Linear)
+    .MagFilter(TextureMagFilter::Linear)
+    .WrapS(TextureWrap::ClampToEdge)
+    .WrapT(TextureWrap::ClampToEdge)
+    .Image3D(0, PixelDataInternalFormat::RGBA8, terrainResolution,
+             terrainResolution, (rangeCount + 3) / 4, 0,
+             PixelDataFormat::RGBA, PixelDataType::UnsignedByte, weights.data());
+    Texture::Active(0);
+    splatMapDirty = false;
+}
+
+void Terrain::generateOcclusionMap()
+{
+    if(!heightmapCreated) return;
+
+    std::shared_ptr<const HeightSnapshot> snapshot = heightSnapshot;
+    float verticalScale = heightScale;
+    float horizontalScale = terrainHorizontalScale;
+    // starting a job ends early the current one
+    occlusionJob.start(snapshot->resolution, [ = ](BakingJob & job)
+    {
+        std::vector<unsigned char> occlusion;
+
+        if(!TerrainMapBaker::bakeAmbientOcclusion(snapshot->values.data(),
+                snapshot->resolution, verticalScale, horizontalScale, occlusion, &job))
+            return;
+
+        // main thread uploads it once the job is collected
+        this->occlusionMapResolution = snapshot->resolution;
+        this->occlusionMapData.swap(occlusion);
+    });
+}
+
+void Terrain::createOcclusionTexture(const unsigned char * texels,
+                                     int resolution)
+{
+    Texture::Active(3);
+    gl.Bound(Texture::Target::_2D, this->terrainOcclusionMap)
+    .MinFilter(TextureMinFilter::Linear)
+    .MagFilter(TextureMagFilter::Linear)
+    .WrapS(TextureWrap::ClampToEdge)
+    .WrapT(TextureWrap::ClampToEdge)
+    .Image2D(0, PixelDataInternalFormat::R8, resolution, resolution, 0,
+             PixelDataFormat::Red, PixelDataType::UnsignedByte, texels);
+    Texture::Active(0);
+}
+
+glm::vec2 Terrain::horizonCoordinates(const glm::vec3 &lightDir) const
+{
+    // same plane and orientation the shadow march uses, it
+    // travels against the light direction on x and z
+    float sector = std::atan2(-lightDir.z, -lightDir.x)
+                   / (2.0f * glm::pi<float>()) * HorizonSectors;
+
+    if(sector < 0.0f) sector += HorizonSectors;
+
+    float horizontal = std::sqrt(lightDir.x * lightDir.x + lightDir.z * lightDir.z);
+    float elevation = std::atan2(lightDir.y, horizontal) / glm::half_pi<float>();
+    return glm::vec2(sector, elevation);
+}
+
+Terrain::~Terrain()
+{
+    // jobs write into members, stop them before anything is destroyed
+    horizonJob.cancel();
+    lightmapJob.cancel();
+    occlusionJob.cancel();
 }
 
 void Terrain::Occlusion(float occlusionStrenght)
@@ -854,5 +1163,5 @@ void Terrain::Occlusion(float occlusionStrenght)
     if(occlusionStrenght < 0.0f) return;
 
     program.Use();
-    Uniform<float>(program, "occlusionStrength").Set(occlusionStrenght);
+    occlusionStrength.Set(occlusionStrenght);
 }
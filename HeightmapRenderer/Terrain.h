@@ -2,27 +2,67 @@
 #include "Heightmap.h"
 #include "TerrainMultiTexture.h"
 #include "TerrainChunksGenerator.h"
+#include "PerformanceGovernor.h"
+#include "BakingJob.h"
+#include "BakeCache.h"
+#include "LightmapCompression.h"
+#include "TerrainMapBaker.h"
+#include "ShadowmapBaker.h"
+#include "TerrainMeshBuilder.h"
 using namespace oglplus;
 
 class Terrain
 {
+    public:
+        // immutable copy of the heightmap values in [0, 1], baking jobs
+        // share it so a new terrain never changes data under them
+        struct HeightSnapshot
+        {
+            int resolution;
+            std::vector<float> values;
+            // content hash, keys the bake cache entries
+            std::uint64_t hash;
+        };
     private:
-        // terrain shader uniforms used in the render loop
-        Uniform<glm::vec3> lightDirection;
-        Uniform<glm::vec3> lightIntensities;
-        Uniform<glm::mat4> modelViewProjection;
-        Uniform<glm::mat4> modelView;
-        Uniform<glm::mat4> normalMatrix;
-        Uniform<GLfloat> currentLightmap;
+        // per frame shader values, mirrors the std140 FrameUniforms block
+        // of the terrain shaders, only vec4 and mat4 so there's no padding
+        struct FrameUniforms
+        {
+            glm::mat4 modelViewProjection;
+            glm::mat4 modelView;
+            glm::mat4 normalMatrix;
+            // xyz camera space light direction
+            glm::vec4 lightDirection;
+            glm::vec4 lightIntensities;
+            // x current lightmap, y first valid slice, z valid slice count
+            glm::vec4 lightmaps;
+            // xy sun horizon coordinates, z horizon shadows enabled
+            glm::vec4 sunHorizon;
+            // min, max and active for every range
+            glm::vec4 terrainRange[TerrainMultiTexture::MAX_TERRAIN_TEXTURE_RANGES];
+        };
+        // uniform buffer binding point shared by the terrain and depth programs
+        static const GLuint FrameUniformsBinding = 0;
+        FrameUniforms frameUniforms;
+        // written once per frame by setProgramUniforms
+        Buffer frameUniformBuffer;
+        // terrain shader uniforms changed from the interface
+        Uniform<glm::vec2> terrainUVScaling;
+        Uniform<GLfloat> occlusionStrength;
     public:
         TerrainChunksGenerator chunkGenerator;
         bool useLoDChunks = false;
+        // lays down depth with a trivial program first so the terrain
+        // fragment shader only runs once per visible pixel
+        bool useDepthPrePass = false;
+        // shadows from the horizon map instead of the time of the day lightmaps
+        bool useHorizonShadows = false;
         // represents the amount of time on daylight
-        const float sunTime = 0.6f;
+        const float sunTime = ShadowmapBaker::SunTime;
         // scales moon height and nightlight
-        const float moonAltitude = 1.3f;
+        const float moonAltitude = ShadowmapBaker::MoonAltitude;
         // scales sun height at daylight
-        const float sunAltitude = 1.9f;
+        const float sunAltitude = ShadowmapBaker::SunAltitude;
         // terrain light direction on time
         glm::vec3 calculateLightDir(float time);
         // terrain light direction and color on time
@@ -31,24 +71,64 @@ class Terrain
         float heightAt(glm::vec2 position);
     private:
         void setProgramUniforms(float time);
+        // draws the visible terrain geometry with the current program
+        unsigned int drawTerrainGeometry(Program &drawProgram);
         // multiplies for current time
         float timeScale;
-        // temporal baked ligthmaps data, deleted once
-        // baking is done
-        unsigned char * terrainLightmapsData;
-        // flag to tell the main thread when lightmap baking is done
-        // upload data to GPU once done
-        std::atomic<bool> bakingDone = false;
-        std::atomic<bool> bakingInProgress = false;
-        std::atomic<bool> earlyExit = false; // used on exit() to stop thread early
+        // scaled time of the last rendered frame
+        float currentTime;
+        // baked lightmaps waiting to be uploaded by the main thread,
+        // slice index and bc4 blocks
+        std::deque<std::pair<int, std::vector<unsigned char>>> bakedSlices;
+        std::mutex bakedSlicesMutex;
+        // uploaded slices form a range that wraps around the day,
+        // starting at validSliceFirst
+        int validSliceFirst;
+        int validSliceCount;
+        // uploads finished lightmaps into the time of the day texture
+        void uploadBakedLightmaps();
         // if enabled changes directional light color based on time
         bool enableTimeOfTheDayColorGrading = true;
-        // thread for baking all time of the day lightmaps
-        std::thread bakingThread;
+        // heightmap values of the current terrain
+        std::shared_ptr<const HeightSnapshot> heightSnapshot;
+        // bakes all time of the day lightmaps
+        BakingJob lightmapJob;
         // freq represents the number of sampler per day
         // for example 24 == 1 shadowmap per hour
-        // call using bakingThread, this is a heavy operation
-        void bakeTimeOfTheDayShadowmap(int lightmapSize);
+        // runs on lightmapJob, this is a heavy operation. slices are
+        // baked from firstSlice outwards and published one by one
+        void bakeTimeOfTheDayShadowmap(BakingJob &job,
+                                       std::shared_ptr<const HeightSnapshot> snapshot,
+                                       ShadowmapBaker::Method method, int sliceCount,
+                                       int lightmapSize, int firstSlice,
+                                       std::uint64_t cacheKey);
+        // bake cache keys, everything that changes the baked texels is hashed
+        std::uint64_t lightmapCacheKey(const HeightSnapshot &snapshot,
+                                       ShadowmapBaker::Method method, int sliceCount,
+                                       int lightmapSize) const;
+        std::uint64_t horizonCacheKey(const HeightSnapshot &snapshot) const;
+        // horizon elevation angle per texel for each azimuth sector, eight bits
+        // each, four sectors per layer of a 2d array texture
+        static const int HorizonSectors = 16;
+        std::vector<unsigned char> horizonMapData;
+        int horizonMapResolution;
+        // the horizon map is baked once per terrain
+        BakingJob horizonJob;
+        void bakeHorizonMap(BakingJob &job,
+                            std::shared_ptr<const HeightSnapshot> snapshot,
+                            std::uint64_t cacheKey);
+        // uploads all the horizon map layers to terrainHorizonMap
+        void createHorizonTexture(const unsigned char * texels, int resolution);
+        // ambient occlusion depends on the mesh scales, rebaked when they change
+        std::vector<unsigned char> occlusionMapData;
+        int occlusionMapResolution;
+        BakingJob occlusionJob;
+        // uploads the ambient occlusion map to terrainOcclusionMap
+        void createOcclusionTexture(const unsigned char * texels, int resolution);
+        // light sector coordinate and normalized elevation for the horizon map
+        glm::vec2 horizonCoordinates(const glm::vec3 &lightDir) const;
+        // algorithm used by the shadowmap generation and baking
+        ShadowmapBaker::Method shadowBakeMethod = ShadowmapBaker::RayMarch;
     private:
         // terrain status indicator
         bool defaultLightmapsBaked = false;
@@ -71,21 +151,50 @@ class Terrain
         int terrainSeed;
         // utilities
         VertexArray terrainMesh;
-        FragmentShader fragmentShader;
-        VertexShader vertexShader;
         Program program;
+        // depth only pre-pass
+        Program depthProgram;
         Context gl;
         // heightmap field texture
         Texture heightmapField;
         // terrain shadows, generated with heightmap info
         Texture terrainShadowmap;
-        // time of the day 3d texture
+        // time of the day lightmaps, bc4 compressed 2d array with one
+        // layer per slice, bound to texture unit 2
         Texture terrainTOTDLightmap;
+        // horizon angles, bound to texture unit 1
+        Texture terrainHorizonMap;
+        // baked ambient occlusion, bound to texture unit 3
+        Texture terrainOcclusionMap;
+        // mesh space normals at heightmap resolution, bound to texture unit 4
+        Texture terrainNormalMap;
+        // uploads the normal map baked from meshHeights, snorm16 x, z pairs
+        void createNormalMap(const short * normals);
+        // texture range weights, a rgba layer per four ranges on texture unit 5
+        Texture terrainSplatMap;
+        // set when the terrain or the texture ranges change
+        bool splatMapDirty;
+        void createSplatMap();
+        // filtered heights createMesh places the vertices at, in [0, 1]
+        std::vector<float> meshHeights;
+        // everything derived from the heightmap values, textures, maps
+        // and their bakes, once the heightmap holds a new terrain. the
+        // mesh heights, normal map and texels stored in a snapshot are
+        // used as they are
+        void heightmapChanged(const TerrainSnapshot * stored = nullptr);
+        // uploads the whole mesh buffers, meshResolution must be set
+        void uploadMesh(const glm::vec3 * vertices, const glm::vec3 * normals,
+                        const glm::vec2 * texCoords, const unsigned int * indices,
+                        size_t indexCount);
         // heightmap generator
         Heightmap heightmap;
         // multitexture handling class
         TerrainMultiTexture terrainTextures;
-        void createTOTD3DTexture();
+        // adapts the lod pixel error to a performance target
+        PerformanceGovernor governor;
+        // allocates the time of the day texture, blocks holds the bc4 data
+        // of every slice. if null no slice is valid until uploaded
+        void createTOTDTexture(const unsigned char * blocks);
     public:
         void initialize();
         void render(float time);
@@ -114,6 +223,10 @@ class Terrain
                            int seed);
         void createMesh(const int meshResExponent);
         void bakeLightmaps(float freq, int lightmapSize);
+        // starts baking the horizon map for the current heightmap
+        void generateHorizonMap();
+        // starts baking the ambient occlusion map with the current scales
+        void generateOcclusionMap();
 
         // terrain multi texture control functions
         void setTextureRepeatFrequency(const glm::vec2 &value);
@@ -123,6 +236,16 @@ class Terrain
         // time parameters
         void EnableTimeOfTheDayColorGrading(bool val) { enableTimeOfTheDayColorGrading = val; }
         void TimeScale(float val) { timeScale = val; }
+        // shadow baking algorithm
+        void BakeMethod(ShadowmapBaker::Method val) { shadowBakeMethod = val; }
+        ShadowmapBaker::Method BakeMethod() const { return shadowBakeMethod; }
+        // background baking status
+        const BakingJob &LightmapJob() const { return lightmapJob; }
+        const BakingJob &HorizonJob() const { return horizonJob; }
+        const BakingJob &OcclusionJob() const { return occlusionJob; }
+
+        // lod threeshold auto tuning
+        PerformanceGovernor &Governor() { return governor; }
 
         // returns terrain multitexture at index
         GLuint getTextureId(int index);
@@ -138,6 +261,11 @@ class Terrain
 
         // saves terrain data to a bmp greyscale file
         void saveTerrainToFile(const std::string &filename);
+        // writes heights, mesh, chunks and finished lightmaps to a
+        // TerrainSnapshot file, false if there's no mesh yet
+        bool saveSnapshot(const std::string &filename);
+        // restores a terrain written by saveSnapshot without generating it
+        bool loadSnapshot(const std::string &filename);
 
         Terrain();
         ~Terrain();
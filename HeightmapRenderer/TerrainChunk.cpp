@@ -2,9 +2,11 @@
 #include "TerrainChunk.h"
 #include "TransformationMatrices.h"
 #include "App.h"
+#include "ProgramCache.h"
 
 bool TerrainChunk::debugMode = false;
 bool TerrainChunk::enableFrustumCulling = true;
+bool TerrainChunk::enableOcclusionCulling = false;
 BoundingBox * TerrainChunk::chunkBBox = nullptr;
 ChunkDetailLevel * TerrainChunk::chunkLod = nullptr;
 
@@ -33,51 +35,8 @@ void TerrainChunk::bindBuffer(Program &program)
     }
 }
 
-void TerrainChunk::chooseLoDLevel(Camera &camera, const glm::vec3 & position)
-{
-    distanceToEye = glm::distance2(position, camera.Position());
-    float C = getCameraConstant(camera);
-    // highest by default
-    currentLoD = ChunkDetailLevel::High;
-
-    for(int i = 0; i < 2; i++)
-    {
-        entropyDistances[i] = C * C * heightChange[i] * heightChange[i];
-
-        if(distanceToEye >
-           // we have to scale the distances with the terrain enlargement
-           entropyDistances[i] * App::Instance()->getTerrain().TerrainHorizontalScale())
-            currentLoD = ChunkDetailLevel::LodLevel(i + 1);
-    }
-}
-
-float TerrainChunk::getCameraConstant(Camera &camera)
-{
-    float A = camera.NearClip() / camera.Frustum().w;
-    float T = (2.0f * chunkLod->Threeshold()) / camera.ScreenSize().y;
-    return A / T;
-}
-
 void TerrainChunk::drawElements(Program &program)
 {
-    static glm::vec3 positionCS, dimensionCS;
-    positionCS = glm::vec3(
-                     (glm::vec4(this->center, 1.0f) * TransformationMatrices::Model())
-                 );
-    dimensionCS = glm::vec3(
-                      (glm::vec4(this->dimension,
-                                 1.0f) * TransformationMatrices::Model())
-                  );
-
-    // frustum culling terrain chunk
-    if(enableFrustumCulling)
-    {
-        if(!App::Instance()->getCamera()
-           .isBoxInFrustum(positionCS, dimensionCS / 2.0f)) return;
-    }
-
-    // calculates distance to camera for lod selection
-    chooseLoDLevel(App::Instance()->getCamera(), positionCS);
     // binds the chunk mesh data
     bindBuffer(program);
     // draw primitives to gpu
@@ -86,212 +45,46 @@ void TerrainChunk::drawElements(Program &program)
         chunkLod->indicesSize(currentLoD),
         DataType::UnsignedInt
     );
+}
 
+void TerrainChunk::drawBoundingBox()
+{
+    glm::vec3 positionCS = glm::vec3(
+                               TransformationMatrices::Model() * glm::vec4(this->center, 1.0f)
+                           );
+    glm::vec3 dimensionCS = glm::vec3(
+                                TransformationMatrices::Model() * glm::vec4(this->dimension, 0.0f)
+                            );
     // changes the current program, draw bboxes around the chunk
-    if(debugMode)
-    {
-        chunkBBox->render(positionCS, dimensionCS);
-    }
+    chunkBBox->render(positionCS, dimensionCS);
 }
 
-TerrainChunk::TerrainChunk(std::vector<glm::vec3> & vertices,
-                           std::vector<glm::vec3> & normals, std::vector<glm::vec2> & texCoords,
-                           ChunkDetailLevel * chunkLod, float maxHeight, float minHeight)
+TerrainChunk::TerrainChunk(const glm::vec3 * vertices,
+                           const glm::vec3 * normals, const glm::vec2 * texCoords,
+                           size_t vertexCount, ChunkDetailLevel * chunkLod,
+                           const TerrainSnapshot::ChunkBounds &bounds)
 {
-    this->vertices = std::move(vertices);
-    this->normals = std::move(normals);
-    this->texCoords = std::move(texCoords);
-
     // only called once, chunk bbox, used for debug
     // only one created, then rendered per chunk translating and scaling it
     if(chunkBBox == nullptr) chunkBBox = new BoundingBox();
 
     // chunk lod controller, shared among all terrain chunks
     this->chunkLod = chunkLod;
-    // get vertex matrix center
-    int halfPoint = chunkLod->ChunkSize() / 2;
-    this->center = this->vertices[halfPoint * chunkLod->ChunkSize() + halfPoint];
-    this->center.y = (maxHeight + minHeight) / 2.0f;
-    // set bounding box chunk data
-    float chunkSpatialSize = (float)(chunkLod->ChunkSize() - 1.0f) /
-                             (chunkLod->MeshSize() - 1.0f);
-    this->dimension =
-        glm::vec3(
-            chunkSpatialSize,
-            maxHeight - minHeight,
-            chunkSpatialSize
-        );
-    //for(int i = 0; i < 2; i++)
-    //{
-    //    int currentLoD = (int)std::pow(2, i);
-    //    // calculate current entropy
-    //    glm::vec3 position = glm::vec3();
-    //    glm::vec3 direction = glm::vec3();
-    //    std::vector<glm::vec3> lVertices;
-    //    std::vector<int> stopLerpToken;
-    //    // extract lower lod vertices
-    //    for each(int index in chunkLod->IndicesLoD()[i + 1])
-    //    {
-    //        index != chunkLod->RestartIndexToken()
-    //        ? lVertices.push_back(this->vertices[index])
-    //        , stopLerpToken.push_back(-1)
-    //        : stopLerpToken.back() = lVertices.size() - 1;
-    //    }
-    //    // calculating the height difference is easy considering
-    //    // the way vertex indexes are ordered, leaving the breaking
-    //    // point of the higher lod just in the middle of the low lod
-    //    // triangle strip lines
-    //    std::vector<float> lowHeight;
-    //    for(int j = 0; j < lVertices.size() - 1; j++)
-    //    {
-    //        if(stopLerpToken[j] == j) continue;
-    //        // calculate the mid point height between vertex lines at this
-    //        // point is where the geomipmap algorithm breaks the higher mesh
-    //        lowHeight.push_back(glm::lerp(lVertices[j], lVertices[j + 1], 0.5f).y);
-    //    }
-    //    int nextSize = (chunkLod->ChunkSize() - 1) / std::pow(2, i) + 1;
-    //    int stepper = 0; int stepMultiplier = std::pow(2, i);
-    //    std::vector<float> realHeight;
-    //    for(int y = 0; y < nextSize - 1; y = stepper * 2)
-    //    {
-    //        stepper++;
-    //        for(int x = 0; x < nextSize; x++)
-    //        {
-    //            int vertIndex = ((y + 1) * chunkLod->ChunkSize() + x) * stepMultiplier;
-    //            realHeight.push_back(this->vertices[vertIndex].y);
-    //        }
-    //    }
-    //    float maxEntropy = 0.0f;
-    //    for(int j = 0; j < realHeight.size(); j++)
-    //    {
-    //        maxEntropy = std::max(maxEntropy, std::abs(realHeight[i] - lowHeight[i]));
-    //    }
-    //    this->heightChange[i] = maxEntropy;
-    //}
-    // slow calculation for entropies
-    std::vector<glm::vec3> lVertices;
-    std::vector<glm::vec3> hVertices;
-
-    for(int i = 0; i < 2; i++)
-    {
-        if(i == 0) hVertices = std::vector<glm::vec3>(this->vertices);
-        else { hVertices = lVertices; lVertices.clear(); }
-
-        int yStepper = 1;
-        int hChunkLodSize = (chunkLod->ChunkSize() - 1) / std::pow(2, i) + 1;
-        int lChunkLodSize = (chunkLod->ChunkSize() - 1) / std::pow(2, i + 1) + 1;
-
-        for(int y = 0; y < hChunkLodSize; y = 2 * yStepper, yStepper++)
-        {
-            int xStepper = 1;
-
-            for(int x = 0; x < hChunkLodSize; x = 2 * xStepper, xStepper++)
-            {
-                lVertices.push_back(hVertices[y * hChunkLodSize + x]);
-            }
-        }
-
-        /************************************************************************/
-        /*
-        x---x---x             x-------x
-        | \ | \ |             | \     |
-        x---x---x  Breaks To  |   \   |
-        | \ | \ |             |     \ |
-        x---x---x             x-------x
-
-        We compare the geometric height error
-        at the vertex loss points, comparing
-        the heigth difference
-        */
-        /************************************************************************/
-        std::vector<float> lHeight;
-        std::vector<float> hHeight;
-
-        for(int y = 0; y < lChunkLodSize; y++)
-        {
-            for(int x = 0; x < lChunkLodSize; x++)
-            {
-                // calculate horizontal lines height loss
-                if(x < lChunkLodSize - 1)
-                {
-                    lHeight.push_back(
-                        glm::lerp(
-                            lVertices[y * lChunkLodSize + x],
-                            lVertices[y * lChunkLodSize + x + 1],
-                            0.5f
-                        ).y
-                    );
-                    // get higher lod original horizontal heights
-                    hHeight.push_back(hVertices[2 * y * hChunkLodSize + 2 * x + 1].y);
-                }
-
-                // calculate vertical height loss
-                if(y < lChunkLodSize - 1)
-                {
-                    lHeight.push_back(
-                        glm::lerp(
-                            lVertices[y * lChunkLodSize + x],
-                            lVertices[(y + 1) * lChunkLodSize + x],
-                            0.5f
-                        ).y
-                    );
-                    // get higher lod original vertical heights
-                    hHeight.push_back(hVertices[(2 * y + 1) * hChunkLodSize + 2 * x].y);
-                }
-
-                // calculate diagonal height loss
-                if(y < lChunkLodSize - 1 && x < lChunkLodSize - 1)
-                {
-                    lHeight.push_back(
-                        glm::lerp(
-                            lVertices[y * lChunkLodSize + x],
-                            lVertices[(y + 1) * lChunkLodSize + x + 1],
-                            0.5f
-                        ).y
-                    );
-                    hHeight.push_back(hVertices[(2 * y + 1) * hChunkLodSize + 2 * x + 1].y);
-                }
-            }
-        }
-
-        float maxEntropy = 0.0f;
-
-        for(int j = 0; j < hHeight.size(); j++)
-        {
-            maxEntropy = std::max(maxEntropy, std::abs(hHeight[i] - lHeight[i]));
-        }
-
-        this->heightChange[i] = maxEntropy;
-    }
-}
-
-void TerrainChunk::bindBufferData(Program &program)
-{
-    // upload position data to the gpu
+    // set bounding box chunk data and geomipmapping height changes
+    this->center = bounds.center;
+    this->dimension = bounds.dimension;
+    this->heightChange[0] = bounds.heightChange[0];
+    this->heightChange[1] = bounds.heightChange[1];
+    // upload the mesh data, attributes are set up by bindBuffer
     buffer[0].Bind(Buffer::Target::Array);
-    {
-        Buffer::Data(Buffer::Target::Array, vertices);
-        // vertices
-        (program | 0).Setup<GLfloat>(3).Enable();
-    }
+    Buffer::Data(Buffer::Target::Array, (GLsizei)vertexCount * 3,
+                 (const GLfloat *)vertices);
     buffer[1].Bind(Buffer::Target::Array);
-    {
-        // upload the data
-        Buffer::Data(Buffer::Target::Array, normals);
-        // normals
-        (program | 1).Setup<GLfloat>(3).Enable();
-    }
+    Buffer::Data(Buffer::Target::Array, (GLsizei)vertexCount * 3,
+                 (const GLfloat *)normals);
     buffer[2].Bind(Buffer::Target::Array);
-    {
-        // upload the data
-        Buffer::Data(Buffer::Target::Array, texCoords);
-        // texture coords
-        (program | 2).Setup<GLfloat>(2).Enable();
-    }
-    // free memory once uploaded to gpu
-    this->vertices.clear();
-    this->normals.clear();
-    this->texCoords.clear();
+    Buffer::Data(Buffer::Target::Array, (GLsizei)vertexCount * 2,
+                 (const GLfloat *)texCoords);
 }
 
 BoundingBox::BoundingBox() : bbox(1, 1, 1),
@@ -299,33 +92,27 @@ BoundingBox::BoundingBox() : bbox(1, 1, 1),
     bboxIndexArray(bbox.Indices()), projectionMatrix(prog), viewMatrix(prog),
     modelMatrix(prog)
 {
-    // Set the vertex shader source and compile it
-    vs.Source((GLSLString)
-              "#version 330\n"
-              "uniform mat4 ProjectionMatrix, CameraMatrix, ModelMatrix;"
-              "in vec4 Position;"
-              "void main(void)"
-              "{"
-              "	gl_Position = "
-              "		ProjectionMatrix *"
-              "		CameraMatrix *"
-              "		ModelMatrix *"
-              "		Position;"
-              "}"
-             ).Compile();
-    // set the fragment shader source and compile it
-    fs.Source((GLSLString)
-              "#version 330\n"
-              "out vec4 fragColor;"
-              "void main(void)"
-              "{"
-              "	fragColor = vec4(1.0f);"
-              "}"
-             ).Compile();
-    // attach the shaders to the program
-    prog.AttachShader(vs).AttachShader(fs);
-    // link and use it
-    prog.Link().Use();
+    // link from the previous run binary or compile the sources
+    ProgramCache::link(prog,
+                       "#version 330\n"
+                       "uniform mat4 ProjectionMatrix, CameraMatrix, ModelMatrix;"
+                       "in vec4 Position;"
+                       "void main(void)"
+                       "{"
+                       "	gl_Position = "
+                       "		ProjectionMatrix *"
+                       "		CameraMatrix *"
+                       "		ModelMatrix *"
+                       "		Position;"
+                       "}",
+                       "#version 330\n"
+                       "out vec4 fragColor;"
+                       "void main(void)"
+                       "{"
+                       "	fragColor = vec4(1.0f);"
+                       "}");
+    // use it
+    prog.Use();
     // initialize the uniforms
     projectionMatrix.BindTo("ProjectionMatrix");
     viewMatrix.BindTo("CameraMatrix");
@@ -1,5 +1,6 @@
 #pragma once
 #include "ChunkDetailLevel.h"
+#include "TerrainSnapshot.h"
 #include "Camera.h"
 using namespace oglplus;
 
@@ -8,10 +9,6 @@ class BoundingBox
     private:
         // wrapper around the current OpenGL context
         Context gl;
-        // Vertex shader
-        VertexShader vs;
-        // Fragment shader
-        FragmentShader fs;
         // Program
         Program prog;
 
@@ -40,6 +37,8 @@ class TerrainChunk
         static BoundingBox * chunkBBox;
         // trapezoid - cube culling per chunk
         static bool enableFrustumCulling;
+        // software occlusion culling against nearer chunks
+        static bool enableOcclusionCulling;
         // bounding box position and dimension
         glm::vec3 position;
         glm::vec3 dimension;
@@ -57,41 +56,35 @@ class TerrainChunk
         ChunkDetailLevel::LodLevel currentLoD;
         // height change between lod levels per chunk
         std::array<float, 2> heightChange;
-        // defines the distance for selecting the lod level
-        std::array<float, 2> entropyDistances;
     private:
         // chunk center vertex
         glm::vec3 center;
-        // mesh data, freed once uploaded to gpu
-        std::vector<glm::vec3> vertices;
-        std::vector<glm::vec3> normals;
-        std::vector<glm::vec2> texCoords;
         // mesh data gpu buffers
         std::array<Buffer, 4> buffer;
         // called on drawElemented
         void bindBuffer(Program &program);
     public:
-        TerrainChunk(std::vector<glm::vec3> & vertices,
-                     std::vector<glm::vec3> & normals,
-                     std::vector<glm::vec2> & texCoords,
+        // uploads vertexCount vertices from each array, nothing is kept
+        // on the cpu side so they can point into a snapshot mapping
+        TerrainChunk(const glm::vec3 * vertices, const glm::vec3 * normals,
+                     const glm::vec2 * texCoords, size_t vertexCount,
                      ChunkDetailLevel * chunkLod,
-                     float maxHeight, float minHeight);
+                     const TerrainSnapshot::ChunkBounds &bounds);
         // chunk num vertices = chunkSizeExponent ^ 2 + 1
         ~TerrainChunk() {};
-        void bindBufferData(Program &program);
-        // calls glDrawElements with the current lod level indices
+        // calls glDrawElements with the current lod level indices, culling
+        // and lod selection are done beforehand by TerrainChunksGenerator
         void drawElements(Program &program);
-        // calculates appropiate lod level
-        void chooseLoDLevel(Camera &camera, const glm::vec3 & position);
-        // returns the C constant for geomipmapping
-        float getCameraConstant(Camera &camera);
-        // generated geometric height changes for geomipmapping (d)
-        void generatedEntropies();
+        // draws the chunk bounding box, changes the current program
+        void drawBoundingBox();
         // render bboxes
         static void DrawBoundingBoxes(bool val) { debugMode = val; }
         static bool DrawingBoundingBoxes() { return debugMode; }
         // culls the chunk bounding boxes with the frustum trapezoid
         static bool EnableFrustumCulling() { return enableFrustumCulling; }
         static void EnableFrustumCulling(bool val) { enableFrustumCulling = val; }
+        // culls the chunks hidden behind nearer terrain
+        static bool EnableOcclusionCulling() { return enableOcclusionCulling; }
+        static void EnableOcclusionCulling(bool val) { enableOcclusionCulling = val; }
 };
 
@@ -1,30 +1,12 @@
 #include "Commons.h"
 #include "TerrainChunksGenerator.h"
 #include "ChunkDetailLevel.h"
+#include "TerrainMeshBuilder.h"
+#include "TransformationMatrices.h"
 
-glm::vec3 & TerrainChunksGenerator::getVertex(int x, int y)
+void TerrainChunksGenerator::setSizes(unsigned int meshSizeExponent,
+                                      unsigned int chunkSizeExponent)
 {
-    return vertices[y * meshSize + x];
-}
-
-glm::vec2 & TerrainChunksGenerator::getTexCoord(int x, int y)
-{
-    return texCoords[y * meshSize + x];
-}
-
-glm::vec3 & TerrainChunksGenerator::getNormal(int x, int y)
-{
-    return normals[y * meshSize + x];
-}
-
-void TerrainChunksGenerator::generateChunks(std::vector<glm::vec3>
-        &meshVertices, std::vector<glm::vec3> &meshNormals,
-        std::vector<glm::vec2> &meshTexCoords, unsigned int meshSizeExponent,
-        unsigned int chunkSizeExponent)
-{
-    this->vertices = std::move(meshVertices);
-    this->normals = std::move(meshNormals);
-    this->texCoords = std::move(meshTexCoords);
     // set mesh params
     this->meshSizeExponent = meshSizeExponent;
     this->chunkSizeExponent = chunkSizeExponent;
@@ -36,66 +18,226 @@ void TerrainChunksGenerator::generateChunks(std::vector<glm::vec3>
     // delete previous chunks and reserve memory for new ones
     deleteMeshChunks();
     this->meshChunks.resize(chunkCount);
-    // create lod controller levels
-    chunkDetail.generateDetailLevels(meshSize, chunkSize);
+}
+
+void TerrainChunksGenerator::generateChunks(const std::vector<glm::vec3>
+        &meshVertices, const std::vector<glm::vec3> &meshNormals,
+        const std::vector<glm::vec2> &meshTexCoords, unsigned int meshSizeExponent,
+        unsigned int chunkSizeExponent)
+{
+    setSizes(meshSizeExponent, chunkSizeExponent);
+    // lod indices and the geomipmapping height changes, the slow part,
+    // are built while the chunk vertices are gathered below
+    std::vector<TerrainSnapshot::ChunkBounds> chunkBounds;
+    JobSystem::JobHandle detailJob = JobSystem::run([&]()
+    {
+        chunkDetail.generateDetailLevels(meshSize, chunkSize);
+    });
+    JobSystem::JobHandle boundsJob = JobSystem::run([&]()
+    {
+        TerrainMeshBuilder::buildChunkBounds(meshVertices, meshSizeExponent,
+                                             chunkSizeExponent, chunkBounds);
+    });
+    std::vector<glm::vec3> chunkVertices;
+    std::vector<glm::vec3> chunkNormals;
+    std::vector<glm::vec2> chunkTexCoords;
+    TerrainMeshBuilder::buildChunkVertices(meshVertices, meshNormals, meshTexCoords,
+                                           meshSizeExponent, chunkSizeExponent,
+                                           chunkVertices, chunkNormals, chunkTexCoords);
+    JobSystem::wait(detailJob);
+    JobSystem::wait(boundsJob);
+    createChunks(chunkVertices.data(), chunkNormals.data(), chunkTexCoords.data(),
+                 chunkBounds.data());
+}
 
+void TerrainChunksGenerator::loadChunks(const TerrainSnapshot &snapshot)
+{
+    setSizes(snapshot.Info().meshSizeExponent, snapshot.Info().chunkSizeExponent);
+    const unsigned int * indices[3];
+    size_t counts[3];
+
+    for(int i = 0; i < 3; i++)
+    {
+        TerrainSnapshot::Section section = (TerrainSnapshot::Section)
+                                           (TerrainSnapshot::LoDHigh + i);
+        indices[i] = (const unsigned int *)snapshot.SectionData(section);
+        counts[i] = snapshot.SectionSize(section) / sizeof(unsigned int);
+    }
+
+    chunkDetail.loadDetailLevels(meshSize, chunkSize, indices, counts);
+    createChunks(
+        (const glm::vec3 *)snapshot.SectionData(TerrainSnapshot::ChunkVertices),
+        (const glm::vec3 *)snapshot.SectionData(TerrainSnapshot::ChunkNormals),
+        (const glm::vec2 *)snapshot.SectionData(TerrainSnapshot::ChunkTexCoords),
+        (const TerrainSnapshot::ChunkBounds *)snapshot.SectionData(
+            TerrainSnapshot::Chunks)
+    );
+}
+
+void TerrainChunksGenerator::createChunks(const glm::vec3 * vertices,
+        const glm::vec3 * normals, const glm::vec2 * texCoords,
+        const TerrainSnapshot::ChunkBounds * bounds)
+{
+    const size_t chunkVertexCount = chunkSize * chunkSize;
+    // one bounding box per chunk
+    chunkCuller.resize(chunkCount * chunkCount);
+    terrainBase = std::numeric_limits<float>::max();
+
+    // chunks own gl buffers, they are created on this thread
     for(int y = 0; y < chunkCount; y++)
     {
         for(int x = 0; x < chunkCount; x++)
         {
-            std::vector<glm::vec3> chunkVertices;
-            std::vector<glm::vec3> chunkNormals;
-            std::vector<glm::vec2> chunkTexCoords;
-
-            for(int i = 0; i < chunkSize; i++)
-            {
-                for(int j = 0; j < chunkSize; j++)
-                {
-                    int xCoord = j + x * (chunkSize - 1);
-                    int yCoord = i + y * (chunkSize - 1);
-                    chunkVertices.push_back(getVertex(xCoord, yCoord));
-                    chunkNormals.push_back(getNormal(xCoord, yCoord));
-                    chunkTexCoords.push_back(getTexCoord(xCoord, yCoord));
-                }
-            }
-
-            // get maximim height for current chunk
-            float chunkMaxHeight = 0.0f;
-            float chunkMinHeight = 1.0f;
-
-            for each(glm::vec3 vertex in chunkVertices)
-            {
-                chunkMaxHeight = vertex.y > chunkMaxHeight ? vertex.y : chunkMaxHeight;
-                chunkMinHeight = vertex.y < chunkMinHeight ? vertex.y : chunkMinHeight;
-            }
-
-            this->meshChunks[y].push_back(
-                new TerrainChunk(
-                    chunkVertices, chunkNormals, chunkTexCoords,
-                    &chunkDetail, chunkMaxHeight, chunkMinHeight
-                )
+            int index = y * chunkCount + x;
+            size_t chunkAt = index * chunkVertexCount;
+            TerrainChunk * chunk = new TerrainChunk(
+                vertices + chunkAt, normals + chunkAt, texCoords + chunkAt,
+                chunkVertexCount, &chunkDetail, bounds[index]
             );
+            this->meshChunks[y].push_back(chunk);
+            chunkCuller.setBox(index, chunk->center, chunk->dimension);
+            terrainBase = std::min(terrainBase,
+                                   chunk->center.y - chunk->dimension.y / 2.0f);
         }
     }
 
     chunkDetail.bindBufferData();
-    // we don't need these collections anymore
-    this->vertices.clear();
-    this->texCoords.clear();
-    this->normals.clear();
+    // new chunks have new height changes
+    switchDistancesDirty = true;
 }
 
-void TerrainChunksGenerator::bindBufferData(Program &program)
+void TerrainChunksGenerator::getChunkBounds(
+    std::vector<TerrainSnapshot::ChunkBounds> &bounds) const
 {
-    for each(std::vector<TerrainChunk *> hLineChunks in this->meshChunks)
+    bounds.resize(chunkCount * chunkCount);
+
+    for(unsigned int y = 0; y < chunkCount; y++)
+    {
+        for(unsigned int x = 0; x < chunkCount; x++)
+        {
+            const TerrainChunk * chunk = meshChunks[y][x];
+            TerrainSnapshot::ChunkBounds &chunkBounds = bounds[y * chunkCount + x];
+            chunkBounds.center = chunk->center;
+            chunkBounds.dimension = chunk->dimension;
+            chunkBounds.heightChange[0] = chunk->heightChange[0];
+            chunkBounds.heightChange[1] = chunk->heightChange[1];
+        }
+    }
+}
+
+void TerrainChunksGenerator::cullChunks(Camera &camera)
+{
+    chunkCuller.cull(
+        camera.Planes(), TransformationMatrices::Model(), camera.Position(),
+        TerrainChunk::EnableFrustumCulling()
+    );
+    // nearest chunks first so early depth testing rejects hidden fragments
+    chunkCuller.sortFrontToBack();
+
+    if(TerrainChunk::EnableOcclusionCulling()) cullOccludedChunks();
+}
+
+void TerrainChunksGenerator::cullOccludedChunks()
+{
+    occlusionCuller.beginFrame(
+        TransformationMatrices::Projection() * TransformationMatrices::View() *
+        TransformationMatrices::Model()
+    );
+    unsigned int occluders = 0;
+    // visible list is sorted front to back, so occluders are
+    // always added before the chunks they can hide
+    chunkCuller.removeVisible([&](unsigned int chunkIndex) -> bool
     {
-        for(unsigned int i = 0; i < hLineChunks.size(); i++)
+        const TerrainChunk * chunk = meshChunks[chunkIndex / chunkCount]
+                                     [chunkIndex % chunkCount];
+        glm::vec3 boxMin = chunk->center - chunk->dimension / 2.0f;
+        glm::vec3 boxMax = chunk->center + chunk->dimension / 2.0f;
+
+        if(occlusionCuller.isOccluded(boxMin, boxMax)) return true;
+
+        // the terrain is solid from its lowest point up to the
+        // chunk minimum height, that slab is a safe occluder
+        if(occluders < MaxOccluders)
         {
-            hLineChunks[i]->bindBufferData(program);
+            occlusionCuller.addOccluder(
+                glm::vec3(boxMin.x, terrainBase, boxMin.z),
+                glm::vec3(boxMax.x, boxMin.y, boxMax.z)
+            );
+            occluders++;
         }
+
+        return false;
+    });
+}
+
+void TerrainChunksGenerator::selectLoDLevels(Camera &camera,
+        float horizontalScale)
+{
+    updateLoDContext(camera, horizontalScale);
+    const std::vector<unsigned int> &visible = chunkCuller.Visible();
+    const std::vector<float> &distances = chunkCuller.Distances();
+    const float * mediumDistances = switchDistances[0].data();
+    const float * lowDistances = switchDistances[1].data();
+    visibleTriangles = 0;
+
+    for(unsigned int i = 0; i < visible.size(); i++)
+    {
+        unsigned int chunkIndex = visible[i];
+        float distanceToEye = distances[i];
+        TerrainChunk * chunk = meshChunks[chunkIndex / chunkCount][chunkIndex %
+                               chunkCount];
+        chunk->distanceToEye = distanceToEye;
+        chunk->currentLoD = distanceToEye > lowDistances[chunkIndex]
+                            ? ChunkDetailLevel::Low
+                            : distanceToEye > mediumDistances[chunkIndex]
+                            ? ChunkDetailLevel::Medium
+                            : ChunkDetailLevel::High;
+        visibleTriangles += chunkDetail.trianglesCount(chunk->currentLoD);
     }
 }
 
+float TerrainChunksGenerator::getCameraConstant(Camera &camera)
+{
+    float A = camera.NearClip() / camera.Frustum().w;
+    float T = (2.0f * ChunkDetailLevel::Threeshold()) / camera.ScreenSize().y;
+    return A / T;
+}
+
+void TerrainChunksGenerator::updateLoDContext(Camera &camera,
+        float horizontalScale)
+{
+    float C = getCameraConstant(camera);
+
+    // switch distances only change with the threeshold, scale or screen size
+    if(!switchDistancesDirty
+       && lodContext.cameraConstant == C
+       && lodContext.horizontalScale == horizontalScale) return;
+
+    lodContext.cameraConstant = C;
+    lodContext.horizontalScale = horizontalScale;
+    unsigned int count = chunkCount * chunkCount;
+
+    for(int i = 0; i < 2; i++)
+    {
+        switchDistances[i].resize(count);
+
+        for(unsigned int j = 0; j < count; j++)
+        {
+            float heightChange = meshChunks[j / chunkCount][j % chunkCount]->heightChange[i];
+            // we have to scale the distances with the terrain enlargement
+            switchDistances[i][j] = C * C * heightChange * heightChange * horizontalScale;
+        }
+    }
+
+    switchDistancesDirty = false;
+}
+
+TerrainChunk & TerrainChunksGenerator::VisibleChunk(int index)
+{
+    unsigned int chunkIndex = chunkCuller.Visible()[index];
+    return *meshChunks[chunkIndex / chunkCount][chunkIndex % chunkCount];
+}
+
 TerrainChunksGenerator::~TerrainChunksGenerator()
 {
     // deallocate chunks
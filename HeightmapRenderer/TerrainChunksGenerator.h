@@ -1,5 +1,8 @@
 #pragma once
 #include "TerrainChunk.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "TerrainSnapshot.h"
 using namespace oglplus;
 
 class TerrainChunksGenerator
@@ -8,10 +11,6 @@ class TerrainChunksGenerator
         Context gl;
     private:
         bool chunksGenerated = false;
-        // helper for getting x, y from contiguos vectors
-        glm::vec3 &getVertex(int x, int y);
-        glm::vec2 &getTexCoord(int x, int y);
-        glm::vec3 &getNormal(int x, int y);
         // mesh parameters data
         unsigned int chunkSize;
         unsigned int meshSize;
@@ -19,28 +18,79 @@ class TerrainChunksGenerator
         unsigned int chunkSizeExponent;
         unsigned int restartIndexToken;
         unsigned int chunkCount;
-        // whole mesh data
-        std::vector<glm::vec3> vertices;
-        std::vector<glm::vec3> normals;
-        std::vector<glm::vec2> texCoords;
         // collection of all mesh chunks
         std::vector<std::vector<TerrainChunk *>> meshChunks;
         // controller for chunk detail level
         ChunkDetailLevel chunkDetail;
+        // all chunk bounding boxes, culled once per frame
+        FrustumCuller chunkCuller;
+        // software depth buffer for chunks hidden behind nearer terrain
+        OcclusionCuller occlusionCuller;
+        // lowest point of the terrain, bottom of the occluder volumes
+        float terrainBase = 0.0f;
+        // only the nearest visible chunks are rasterized as occluders
+        static const unsigned int MaxOccluders = 32;
+        // removes visible chunks hidden behind nearer chunks
+        void cullOccludedChunks();
+        // level of detail selection constants, shared by all chunks
+        struct LoDContext
+        {
+            // geomipmapping C constant, depends on the near clip, frustum,
+            // screen height and pixel error threeshold
+            float cameraConstant;
+            float horizontalScale;
+        } lodContext;
+        // squared eye distance per chunk at which the medium and low
+        // levels are selected, rebuilt only when lodContext changes
+        std::array<std::vector<float>, 2> switchDistances;
+        bool switchDistancesDirty = true;
+        // triangles of all visible chunks at their selected lod
+        unsigned int visibleTriangles = 0;
+        // recalculates the frame lod context and the switch distances if needed
+        void updateLoDContext(Camera &camera, float horizontalScale);
         // deletes all mesh chunks
         void deleteMeshChunks();
+        // sets the mesh parameters and deletes the previous chunks
+        void setSizes(unsigned int meshSizeExponent, unsigned int chunkSizeExponent);
+        // creates every chunk and uploads its buffers, the vertex arrays
+        // hold whole chunks one after the other, bounds one per chunk
+        void createChunks(const glm::vec3 * vertices, const glm::vec3 * normals,
+                          const glm::vec2 * texCoords,
+                          const TerrainSnapshot::ChunkBounds * bounds);
     public:
-        // generates all terrain chunks
-        void generateChunks(std::vector<glm::vec3> &meshVertices,
-                            std::vector<glm::vec3> &meshNormals,
-                            std::vector<glm::vec2> &meshTexCoords,
+        // generates all terrain chunks from the whole mesh buffers
+        void generateChunks(const std::vector<glm::vec3> &meshVertices,
+                            const std::vector<glm::vec3> &meshNormals,
+                            const std::vector<glm::vec2> &meshTexCoords,
                             unsigned int meshSizeExponent,
                             unsigned int chunkSizeExponent);
-        // uploads all the chunks buffer objects to the gpu
-        void bindBufferData(Program &program);
+        // chunks, bounds and lod indices stored in snapshot, everything is
+        // uploaded straight from its mapping
+        void loadChunks(const TerrainSnapshot &snapshot);
+        // bounds and height changes of every chunk, row order
+        void getChunkBounds(std::vector<TerrainSnapshot::ChunkBounds> &bounds) const;
+        // culls every chunk bounding box against the camera frustum,
+        // visible chunks are ordered front to back
+        void cullChunks(Camera &camera);
+        // chooses the lod level of every visible chunk, call after cullChunks
+        void selectLoDLevels(Camera &camera, float horizontalScale);
+        // returns the C constant for geomipmapping
+        static float getCameraConstant(Camera &camera);
         // generated chunks
         TerrainChunk &MeshChunk(int x, int y) { return *meshChunks[x][y]; }
         unsigned int ChunkCount() const { return chunkCount; }
+        unsigned int MeshSizeExponent() const { return meshSizeExponent; }
+        unsigned int ChunkSizeExponent() const { return chunkSizeExponent; }
+        // chunks that passed the last cullChunks call
+        unsigned int VisibleCount() const { return chunkCuller.Visible().size(); }
+        TerrainChunk &VisibleChunk(int index);
+        // chunks tested and rejected by occlusion culling on the last frame
+        unsigned int OcclusionTested() const { return occlusionCuller.TestedCount(); }
+        unsigned int OcclusionCulled() const { return occlusionCuller.CulledCount(); }
+        // triangles to be drawn after selectLoDLevels
+        unsigned int VisibleTriangles() const { return visibleTriangles; }
+        // squared distance to the eye of a visible chunk
+        float VisibleDistance(int index) const { return chunkCuller.Distances()[index]; }
 
         TerrainChunksGenerator() {};
         ~TerrainChunksGenerator();
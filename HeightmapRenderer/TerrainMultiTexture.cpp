@@ -2,11 +2,9 @@
 #include "TerrainMultiTexture.h"
 
 
-void TerrainMultiTexture::loadTexture(const std::string &filepath,
-                                      const int index)
+bool TerrainMultiTexture::decodeImage(const std::string &filepath,
+                                      std::vector<unsigned char> &texels)
 {
-    if(index < 0 || index >= MAX_TERRAIN_TEXTURE_RANGES) return;
-
     FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(filepath.c_str());
 
     //if still unknown, try to guess the file format from the file extension
@@ -15,69 +13,227 @@ void TerrainMultiTexture::loadTexture(const std::string &filepath,
         fif = FreeImage_GetFIFFromFilename(filepath.c_str());
     }
 
-    //if still unkown, exit
-    if(fif == FIF_UNKNOWN)
+    //if still unkown or the plugin can't read it, exit
+    if(fif == FIF_UNKNOWN || !FreeImage_FIFSupportsReading(fif))
     {
-        return;
+        return false;
     }
 
     // pointer to the image once loaded
-    FIBITMAP *dib = 0;
+    FIBITMAP *dib = FreeImage_Load(fif, filepath.c_str());
 
-    //check that the plugin has reading capabilities and load the file
-    if(FreeImage_FIFSupportsReading(fif))
-    {
-        dib = FreeImage_Load(fif, filepath.c_str());
-    }
+    if(!dib) return false;
+
+    // highest quality rescaleing, every step returns a new bitmap
+    FIBITMAP *rescaled = FreeImage_Rescale(dib, TEXTURE_SIZE, TEXTURE_SIZE,
+                                           FILTER_BICUBIC);
+    FreeImage_Unload(dib);
+
+    if(!rescaled) return false;
 
-    // highest quality rescaleing
-    dib = FreeImage_Rescale(dib, 512, 512, FILTER_BICUBIC);
     // no alpha channel for terrain textures
-    dib = FreeImage_ConvertTo24Bits(dib);
-    // dib = FreeImage_ConvertTo32Bits(dib);
-    // get raw data
-    unsigned char * bits = FreeImage_GetBits(dib);
+    FIBITMAP *converted = FreeImage_ConvertTo24Bits(rescaled);
+    FreeImage_Unload(rescaled);
+
+    if(!converted) return false;
+
     // get image data
-    unsigned int width = FreeImage_GetWidth(dib);
-    unsigned int height = FreeImage_GetHeight(dib);
-    unsigned int bitsPerPixel = FreeImage_GetBPP(dib);
+    unsigned int width = FreeImage_GetWidth(converted);
+    unsigned int height = FreeImage_GetHeight(converted);
+    unsigned int bitsPerPixel = FreeImage_GetBPP(converted);
+    bool valid = bitsPerPixel == 24 && width == TEXTURE_SIZE
+                 && height == TEXTURE_SIZE;
 
-    // If this somehow one of these failed (they shouldn't), return failure
-    if((bitsPerPixel == 0) || (height == 0) || (width == 0))
+    if(valid)
     {
-        FreeImage_Unload(dib);
-        return;
+        // freeimage rows may be padded, keep them tightly packed
+        unsigned int rowSize = width * 3;
+        unsigned int pitch = FreeImage_GetPitch(converted);
+        const unsigned char * bits = FreeImage_GetBits(converted);
+        texels.resize(rowSize * height);
+
+        for(unsigned int y = 0; y < height; y++)
+        {
+            std::memcpy(&texels[y * rowSize], bits + y * pitch, rowSize);
+        }
     }
 
-    // pass data to the texture array
-    gl.Bound(Texture::Target::_2DArray, this->texture)
-    .MinFilter(TextureMinFilter::LinearMipmapLinear)
-    .MagFilter(TextureMagFilter::Linear)
-    .GenerateMipmap()
-    .WrapS(TextureWrap::Repeat)
-    .WrapT(TextureWrap::Repeat)
-    .Anisotropy(16.0f)
-    .SubImage3D(0, 0, 0, index, 512, 512, 1, PixelDataFormat::BGR,
-                PixelDataType::UnsignedByte, bits);
-    // pass data to interface texture
-    gl.Bound(Texture::Target::_2D, this->uiTextures[index])
-    .Image2D(0, PixelDataInternalFormat::RGB8, 512, 512, 0, PixelDataFormat::BGR,
-             PixelDataType::UnsignedByte, bits)
-    .MinFilter(TextureMinFilter::Nearest)
-    .MagFilter(TextureMagFilter::Nearest)
-    .WrapS(TextureWrap::ClampToEdge)
-    .WrapT(TextureWrap::ClampToEdge);
-    // unload data from memory once uploaded to gpu
-    FreeImage_Unload(dib);
-    // set range as texture active
-    this->ranges[index * 3 + 2] = 1.0f;
+    FreeImage_Unload(converted);
+    return valid;
+}
+
+void TerrainMultiTexture::generateMipmaps(
+    std::vector<std::vector<unsigned char>> &levels)
+{
+    // srgb to linear lookup, linear values go back through the exact curve
+    float toLinear[256];
+
+    for(int i = 0; i < 256; i++)
+    {
+        float value = i / 255.0f;
+        toLinear[i] = value <= 0.04045f ? value / 12.92f
+                      : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    levels.resize(MIPMAP_LEVELS);
+    int size = TEXTURE_SIZE;
+
+    for(int level = 1; level < MIPMAP_LEVELS; level++)
+    {
+        const std::vector<unsigned char> &source = levels[level - 1];
+        const int sourceRow = size * 3;
+        size /= 2;
+        std::vector<unsigned char> &target = levels[level];
+        target.resize(size * size * 3);
+
+        for(int y = 0; y < size; y++)
+        {
+            for(int x = 0; x < size * 3; x++)
+            {
+                // same channel of the 2x2 source texels
+                const unsigned char * texel = &source[2 * y * sourceRow
+                                                      + 2 * (x - x % 3) + x % 3];
+                float linear = (toLinear[texel[0]] + toLinear[texel[3]]
+                                + toLinear[texel[sourceRow]]
+                                + toLinear[texel[sourceRow + 3]]) / 4.0f;
+                float value = linear <= 0.0031308f ? linear * 12.92f
+                              : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+                target[y * size * 3 + x] = (unsigned char)(value * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+bool TerrainMultiTexture::convertImage(const std::string &filepath,
+                                       std::vector<std::vector<unsigned char>> &levels)
+{
+    levels.resize(1);
+
+    if(!decodeImage(filepath, levels[0])) return false;
+
+    generateMipmaps(levels);
+    int size = TEXTURE_SIZE;
+
+    for(auto &level : levels)
+    {
+        std::vector<unsigned char> blocks(TextureContainer::levelSize(size, size));
+        TextureContainer::encodeBC1(level.data(), size, size, blocks.data());
+        level.swap(blocks);
+        size = std::max(1, size / 2);
+    }
+
+    return true;
+}
+
+void TerrainMultiTexture::loadTexture(const std::string &filepath,
+                                      const int index)
+{
+    if(index < 0 || index >= MAX_TERRAIN_TEXTURE_RANGES) return;
+
+    // image i/o never blocks the gl thread, starting a job ends
+    // early the current one for this range
+    loadJobs[index].start(2, [this, filepath, index](BakingJob & job)
+    {
+        LoadedTexture loaded;
+        loaded.index = index;
+        std::string containerPath = TextureContainer::isContainer(filepath) ? filepath
+                                    : TextureContainer::containerPath(filepath);
+        std::shared_ptr<TextureContainer> container =
+            std::make_shared<TextureContainer>();
+
+        // already converted, upload straight from the mapped file
+        if(container->open(containerPath)
+           && container->Width() == TEXTURE_SIZE
+           && container->Height() == TEXTURE_SIZE
+           && container->LevelCount() == MIPMAP_LEVELS)
+        {
+            loaded.container = container;
+            job.advance(2);
+        }
+        else
+        {
+            container.reset();
+
+            if(!convertImage(filepath, loaded.levels) || job.CancelRequested()) return;
+
+            job.advance();
+            // the next load of this image maps it instead
+            TextureContainer::write(containerPath, TEXTURE_SIZE, TEXTURE_SIZE,
+                                    loaded.levels);
+            job.advance();
+        }
+
+        if(job.CancelRequested()) return;
+
+        std::lock_guard<std::mutex> lock(loadedTexturesMutex);
+        loadedTextures.push_back(std::move(loaded));
+    });
+}
+
+void TerrainMultiTexture::uploadLoadedTextures()
+{
+    std::deque<LoadedTexture> loaded;
+    {
+        std::lock_guard<std::mutex> lock(loadedTexturesMutex);
+        loaded.swap(loadedTextures);
+    }
+
+    // join the finished loaders
+    for(auto &job : loadJobs) job.collect();
+
+    for(auto &image : loaded)
+    {
+        int size = TEXTURE_SIZE;
+        gl.Bind(Texture::Target::_2DArray, this->texture);
+
+        // pass the mip chain to the texture array
+        for(int level = 0; level < MIPMAP_LEVELS; level++, size /= 2)
+        {
+            const unsigned char * blocks = image.container
+                                           ? image.container->LevelData(level)
+                                           : image.levels[level].data();
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, image.index,
+                                      size, size, 1, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT,
+                                      (GLsizei)TextureContainer::levelSize(size, size), blocks);
+        }
+
+        // pass data to interface texture
+        gl.Bound(Texture::Target::_2D, this->uiTextures[image.index])
+        .MinFilter(TextureMinFilter::Nearest)
+        .MagFilter(TextureMagFilter::Nearest)
+        .WrapS(TextureWrap::ClampToEdge)
+        .WrapT(TextureWrap::ClampToEdge);
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                               TEXTURE_SIZE, TEXTURE_SIZE, 0,
+                               (GLsizei)TextureContainer::levelSize(TEXTURE_SIZE, TEXTURE_SIZE),
+                               image.container ? image.container->LevelData(0)
+                               : image.levels[0].data());
+        // set range as texture active
+        this->ranges[image.index * 3 + 2] = 1.0f;
+    }
 }
 
 TerrainMultiTexture::TerrainMultiTexture()
 {
+    gl.Bind(Texture::Target::_2DArray, this->texture);
+
+    // bc1 storage for the whole mip chain, loaders fill every level
+    for(int level = 0, size = TEXTURE_SIZE; level < MIPMAP_LEVELS;
+        level++, size /= 2)
+    {
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level,
+                               GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, size, size,
+                               MAX_TERRAIN_TEXTURE_RANGES, 0,
+                               (GLsizei)(TextureContainer::levelSize(size, size)
+                                         * MAX_TERRAIN_TEXTURE_RANGES), nullptr);
+    }
+
     gl.Bound(Texture::Target::_2DArray, this->texture)
-    .Image3D(0, PixelDataInternalFormat::SRGB8, 512, 512, 4, 0,
-             PixelDataFormat::BGR, PixelDataType::UnsignedByte, nullptr);
+    .MinFilter(TextureMinFilter::LinearMipmapLinear)
+    .MagFilter(TextureMagFilter::Linear)
+    .WrapS(TextureWrap::Repeat)
+    .WrapT(TextureWrap::Repeat)
+    .Anisotropy(16.0f);
 
     for(int i = 0; i < MAX_TERRAIN_TEXTURE_RANGES; i++)
     {
@@ -100,12 +256,6 @@ void TerrainMultiTexture::SetTextureRange(const int index, const float start,
     this->ranges[index * 3 + 1] = end;
 }
 
-void TerrainMultiTexture::SetUniforms(Program &program)
-{
-    Uniform<Vec3f>(program, "terrainRange").SetValues(3 *
-            MAX_TERRAIN_TEXTURE_RANGES, ranges);
-}
-
 GLuint TerrainMultiTexture::UITextureId(const int index)
 {
     return index >= 0 && index < MAX_TERRAIN_TEXTURE_RANGES ?
@@ -1,24 +1,59 @@
 #pragma once
+#include "BakingJob.h"
+#include "TextureContainer.h"
 using namespace oglplus;
 
 class TerrainMultiTexture
 {
-    private:
+    public:
         static const int MAX_TERRAIN_TEXTURE_RANGES = 4;
+    private:
+        // every texture is resized to this, with a full mip chain
+        static const int TEXTURE_SIZE = 512;
+        static const int MIPMAP_LEVELS = 10;
 
         Texture texture;
         std::array<Texture, MAX_TERRAIN_TEXTURE_RANGES> uiTextures;
         Context gl;
         // range
         GLfloat ranges[MAX_TERRAIN_TEXTURE_RANGES * 3];
+        // bc1 blocks of every mip level, finest first, either mapped
+        // from a container or converted from an image file
+        struct LoadedTexture
+        {
+            int index;
+            std::shared_ptr<TextureContainer> container;
+            std::vector<std::vector<unsigned char>> levels;
+        };
+        // textures decoded by the loaders, uploaded by the gl thread
+        std::deque<LoadedTexture> loadedTextures;
+        std::mutex loadedTexturesMutex;
+        // one loader per range, a new load ends early the previous one
+        std::array<BakingJob, MAX_TERRAIN_TEXTURE_RANGES> loadJobs;
+        // runs on a loader, load, convert and resize the image file
+        static bool decodeImage(const std::string &filepath,
+                                std::vector<unsigned char> &texels);
+        // box filters the chain from levels[0], averaging in linear space
+        // as the texture array stores srgb
+        static void generateMipmaps(std::vector<std::vector<unsigned char>> &levels);
 
     public:
+        // decodes, mipmaps and compresses an image file into bc1 levels,
+        // usable offline to write containers with TextureContainer::write
+        static bool convertImage(const std::string &filepath,
+                                 std::vector<std::vector<unsigned char>> &levels);
+        // loads on a worker thread, the texture shows up after
+        // uploadLoadedTextures is called once it's done. a container
+        // next to the image is preferred, and written if missing
         void loadTexture(const std::string &filepath, const int index);
+        // uploads decoded textures, call from the gl thread
+        void uploadLoadedTextures();
         TerrainMultiTexture();
         ~TerrainMultiTexture();
 
         void SetTextureRange(const int index, const float start, const float end);
-        void SetUniforms(Program &program);
+        // min, max and active for every range
+        const GLfloat * Ranges() const { return ranges; }
         GLuint UITextureId(const int index);
 };
 
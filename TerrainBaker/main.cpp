@@ -0,0 +1,354 @@
+#include "Commons.h"
+#include "Heightmap.h"
+#include "TerrainMeshBuilder.h"
+#include "ShadowmapBaker.h"
+#include "LightmapCompression.h"
+#include "TerrainSnapshot.h"
+#include "TerrainMapBaker.h"
+#include "BakeCache.h"
+#include "Parallel.h"
+
+// generates, bakes and writes terrains for a list of seeds without a
+// window or an opengl context, timing every stage
+
+enum Stage
+{
+    Generate = 0,
+    Mesh,
+    Chunks,
+    Lightmaps,
+    Write,
+    StageCount
+};
+
+static const char * stageNames[StageCount] =
+{
+    "generate", "mesh", "chunks", "lightmaps", "write"
+};
+
+struct Options
+{
+    // heightmap is 2^sizeExponent wide, the mesh 2^meshExponent + 1
+    int sizeExponent;
+    int meshExponent;
+    float sampleSquare[3];
+    // time of the day slices, none if zero
+    int lightmapSlices;
+    int lightmapSize;
+    ShadowmapBaker::Method method;
+    bool writeBitmap;
+    std::string output;
+    std::vector<int> seeds;
+
+    // same terrain the renderer starts with
+    Options() : sizeExponent(8), meshExponent(8), lightmapSlices(0),
+        lightmapSize(256), method(ShadowmapBaker::RayMarch), writeBitmap(true),
+        output(".")
+    {
+        sampleSquare[0] = 0.0f;
+        sampleSquare[1] = 0.0f;
+        sampleSquare[2] = 5.0f;
+    }
+};
+
+static void printUsage()
+{
+    std::cout <<
+              "usage: TerrainBaker [options] seed...\n"
+              "  seeds are integers or inclusive ranges as first..last\n"
+              "  -s, --size <exp>         heightmap of 2^exp texels wide (8)\n"
+              "  -m, --mesh <exp>         mesh of 2^exp + 1 vertices wide (8)\n"
+              "  -r, --range <x> <y> <z>  noise sample square (0 0 5)\n"
+              "  -l, --lightmaps <count>  time of the day lightmap slices (0)\n"
+              "  --lightmap-size <size>   lightmap texels wide (256)\n"
+              "  --sweep                  bake the lightmaps with the sweep method\n"
+              "  --no-bitmap              skip writing the heightmap bmp\n"
+              "  -o, --output <dir>       directory for the written files (.)\n";
+}
+
+static bool parseInt(const char * text, int &value)
+{
+    char * end = nullptr;
+    long parsed = std::strtol(text, &end, 10);
+
+    if(end == text || *end != '\0') return false;
+
+    value = (int)parsed;
+    return true;
+}
+
+static bool parseOptions(int argc, char * argv[], Options &options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        // options taking values check they are there
+        bool hasValue = i + 1 < argc;
+
+        if((argument == "-s" || argument == "--size") && hasValue)
+        {
+            if(!parseInt(argv[++i], options.sizeExponent)) return false;
+        }
+        else if((argument == "-m" || argument == "--mesh") && hasValue)
+        {
+            if(!parseInt(argv[++i], options.meshExponent)) return false;
+        }
+        else if((argument == "-r" || argument == "--range") && i + 3 < argc)
+        {
+            for(int j = 0; j < 3; j++)
+            {
+                options.sampleSquare[j] = (float)std::atof(argv[++i]);
+            }
+        }
+        else if((argument == "-l" || argument == "--lightmaps") && hasValue)
+        {
+            if(!parseInt(argv[++i], options.lightmapSlices)) return false;
+        }
+        else if(argument == "--lightmap-size" && hasValue)
+        {
+            if(!parseInt(argv[++i], options.lightmapSize)) return false;
+        }
+        else if(argument == "--sweep")
+        {
+            options.method = ShadowmapBaker::Sweep;
+        }
+        else if(argument == "--no-bitmap")
+        {
+            options.writeBitmap = false;
+        }
+        else if((argument == "-o" || argument == "--output") && hasValue)
+        {
+            options.output = argv[++i];
+        }
+        else
+        {
+            // a seed or a range of seeds
+            size_t separator = argument.find("..");
+            int first, last;
+
+            if(separator == std::string::npos)
+            {
+                if(!parseInt(argument.c_str(), first)) return false;
+
+                last = first;
+            }
+            else if(!parseInt(argument.substr(0, separator).c_str(), first)
+                    || !parseInt(argument.substr(separator + 2).c_str(), last)
+                    || last < first)
+            {
+                return false;
+            }
+
+            for(int seed = first; seed <= last; seed++)
+            {
+                options.seeds.push_back(seed);
+            }
+        }
+    }
+
+    // same limits the interface allows
+    return !options.seeds.empty()
+           && options.sizeExponent >= 1 && options.sizeExponent <= 14
+           && options.meshExponent >= TerrainMeshBuilder::ChunkSizeExponent
+           && options.meshExponent <= 14
+           && options.lightmapSlices >= 0
+           && options.lightmapSize >= 4 && options.lightmapSize <= 4096;
+}
+
+// generates, bakes and writes the terrain for seed, times holds the
+// milliseconds every stage took
+static bool bakeTerrain(Heightmap &heightmap, const Options &options, int seed,
+                        double times[StageCount])
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point stageStart = Clock::now();
+    // milliseconds since the last call
+    auto lap = [&stageStart]() -> double
+    {
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double, std::milli>(now - stageStart).count();
+        stageStart = now;
+        return elapsed;
+    };
+    const int resolution = 1 << options.sizeExponent;
+    // same calls createTerrain does
+    heightmap.setSeed(seed);
+    heightmap.setSize(resolution, resolution);
+    heightmap.setBounds(options.sampleSquare[0], options.sampleSquare[2],
+                        options.sampleSquare[1], options.sampleSquare[2]);
+    heightmap.build();
+    // raw values for the snapshot, clamped to [0, 1] for the shadows
+    // as the renderer bakes its lightmaps from them
+    std::vector<float> heights(resolution * resolution);
+    std::vector<float> shadowHeights(resolution * resolution);
+    Parallel::forEach(0, resolution, [&](int y)
+    {
+        for(int x = 0; x < resolution; x++)
+        {
+            float value = heightmap.getValue(x, y);
+            heights[y * resolution + x] = value;
+            shadowHeights[y * resolution + x] = std::min(std::max(value, 0.0f), 1.0f);
+        }
+    });
+    // the renderer keys its bake cache with it
+    std::uint64_t heightHash = BakeCache::hash(shadowHeights.data(),
+                               shadowHeights.size() * sizeof(float));
+    times[Generate] = lap();
+    // filtered heights and the normal map heightmapChanged bakes
+    std::vector<float> meshHeights(resolution * resolution);
+    Parallel::forEach(0, resolution, [&](int y)
+    {
+        for(int x = 0; x < resolution; x++)
+        {
+            meshHeights[y * resolution + x] =
+                TerrainMeshBuilder::vertexHeight(heightmap, x, y);
+        }
+    });
+    std::vector<short> normalMap;
+    TerrainMapBaker::bakeNormalMap(meshHeights.data(), resolution, normalMap);
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<unsigned int> indices;
+    TerrainMeshBuilder::buildMesh(heightmap, options.meshExponent, vertices,
+                                  normals, texCoords, indices);
+    times[Mesh] = lap();
+    std::vector<glm::vec3> chunkVertices;
+    std::vector<glm::vec3> chunkNormals;
+    std::vector<glm::vec2> chunkTexCoords;
+    TerrainMeshBuilder::buildChunkVertices(vertices, normals, texCoords,
+                                           options.meshExponent,
+                                           TerrainMeshBuilder::ChunkSizeExponent,
+                                           chunkVertices, chunkNormals, chunkTexCoords);
+    std::vector<TerrainSnapshot::ChunkBounds> chunkBounds;
+    TerrainMeshBuilder::buildChunkBounds(vertices, options.meshExponent,
+                                         TerrainMeshBuilder::ChunkSizeExponent, chunkBounds);
+    std::array<std::vector<unsigned int>, 3> lodIndices;
+    TerrainMeshBuilder::buildLoDIndices((1 << options.meshExponent) + 1,
+                                        (1 << TerrainMeshBuilder::ChunkSizeExponent) + 1,
+                                        lodIndices);
+    times[Chunks] = lap();
+    // bc4 works on 4x4 blocks
+    const int lightmapSize = (options.lightmapSize + LightmapCompression::BlockSize - 1)
+                             / LightmapCompression::BlockSize * LightmapCompression::BlockSize;
+    const size_t blocksSize = LightmapCompression::blocksSize(lightmapSize);
+    std::vector<unsigned char> lightmapBlocks(blocksSize * options.lightmapSlices);
+
+    if(options.lightmapSlices > 0)
+    {
+        std::vector<float> resampled;
+        unsigned int rowStride = ShadowmapBaker::resampleShadowHeights(
+                                     shadowHeights.data(), resolution, lightmapSize, resampled);
+        std::vector<unsigned char> lightmap;
+
+        for(int slice = 0; slice < options.lightmapSlices; slice++)
+        {
+            ShadowmapBaker::generateShadowmap(
+                options.method,
+                ShadowmapBaker::lightDirection(
+                    ShadowmapBaker::sliceTime(slice, options.lightmapSlices)),
+                lightmap, lightmapSize, resampled, rowStride, nullptr
+            );
+            LightmapCompression::encodeBC4(lightmap, lightmapSize,
+                                           lightmapBlocks.data() + slice * blocksSize);
+        }
+    }
+
+    times[Lightmaps] = lap();
+    TerrainSnapshot::Description description;
+    description.terrainResolution = resolution;
+    description.meshSizeExponent = options.meshExponent;
+    description.chunkSizeExponent = TerrainMeshBuilder::ChunkSizeExponent;
+    description.seed = seed;
+    description.sampleSquare[0] = options.sampleSquare[0];
+    description.sampleSquare[1] = options.sampleSquare[1];
+    description.sampleSquare[2] = options.sampleSquare[2];
+    description.lightmapSize = options.lightmapSlices > 0 ? lightmapSize : 0;
+    description.lightmapSlices = options.lightmapSlices;
+    description.heightHash = heightHash;
+    const void * sections[TerrainSnapshot::SectionCount] =
+    {
+        heights.data(), heightmap.RawImage(), meshHeights.data(),
+        normalMap.data(), vertices.data(), normals.data(), texCoords.data(),
+        indices.data(), chunkVertices.data(), chunkNormals.data(),
+        chunkTexCoords.data(), chunkBounds.data(), lodIndices[0].data(),
+        lodIndices[1].data(), lodIndices[2].data(), lightmapBlocks.data()
+    };
+    std::string filename = options.output + "/terrain" + std::to_string(seed);
+    bool written = TerrainSnapshot::write(filename + TerrainSnapshot::extension,
+                                          description, sections);
+
+    if(written && options.writeBitmap) heightmap.writeToFile(filename);
+
+    times[Write] = lap();
+    return written;
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+
+    if(!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+#ifdef _WIN32
+    CreateDirectoryA(options.output.c_str(), NULL);
+#else
+    mkdir(options.output.c_str(), 0755);
+#endif
+    // noise modules are set up once, every seed rebuilds the same heightmap
+    Heightmap heightmap;
+    double totals[StageCount] = {};
+    int failed = 0;
+    JobSystem::resetStats();
+
+    for(int seed : options.seeds)
+    {
+        double times[StageCount];
+
+        if(!bakeTerrain(heightmap, options, seed, times))
+        {
+            std::cerr << "TerrainBaker: couldn't write the snapshot of seed "
+                      << seed << " to " << options.output << std::endl;
+            failed++;
+        }
+
+        std::printf("seed %d:", seed);
+
+        for(int stage = 0; stage < StageCount; stage++)
+        {
+            std::printf(" %s %.1f ms%s", stageNames[stage], times[stage],
+                        stage + 1 < StageCount ? "," : "\n");
+            totals[stage] += times[stage];
+        }
+    }
+
+    // averages per stage over every seed
+    double total = 0.0;
+    std::printf("\n%-10s %12s %12s\n", "stage", "total ms", "average ms");
+
+    for(int stage = 0; stage < StageCount; stage++)
+    {
+        std::printf("%-10s %12.1f %12.1f\n", stageNames[stage], totals[stage],
+                    totals[stage] / options.seeds.size());
+        total += totals[stage];
+    }
+
+    std::printf("%-10s %12.1f %12.1f\n", "all", total, total / options.seeds.size());
+    // how busy the job system kept its workers over the whole run
+    std::vector<JobSystem::WorkerStats> workerStats;
+    JobSystem::workerStats(workerStats);
+    std::printf("\n%-10s %12s %12s %12s\n", "worker", "jobs", "steals", "busy %");
+
+    for(size_t i = 0; i < workerStats.size(); i++)
+    {
+        std::printf("%-10u %12u %12u %12.1f\n", (unsigned int)i, workerStats[i].jobs,
+                    workerStats[i].steals, workerStats[i].utilization * 100.0f);
+    }
+
+    return failed > 0 ? 2 : 0;
+}
+
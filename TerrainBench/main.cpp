@@ -0,0 +1,705 @@
+#include "Commons.h"
+#include "Heightmap.h"
+#include "TerrainMeshBuilder.h"
+#include "ShadowmapBaker.h"
+#include "FrustumCuller.h"
+#include "TerrainSnapshot.h"
+#include "TerrainMapBaker.h"
+#include "BakeCache.h"
+#include "JobSystem.h"
+#include "Parallel.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+// times the cpu hot paths of the terrain pipeline without a window or an
+// opengl context and writes the results as json, so runs of different
+// builds can be compared
+
+struct Options
+{
+    // every case runs at least this long, seconds
+    double minTime;
+    // largest noise map and lightmap measured
+    int maxSize;
+    // only cases whose name contains it
+    std::string filter;
+    // json destination, standard output if empty
+    std::string output;
+
+    Options() : minTime(0.5), maxSize(4096)
+    {
+    }
+};
+
+struct Result
+{
+    std::string name;
+    int iterations;
+    // milliseconds per iteration
+    double meanTime;
+    double fastestTime;
+    // items one iteration processes and what they are
+    double items;
+    const char * itemName;
+};
+
+// a case stops repeating after this many iterations even under minTime
+static const int MaxIterations = 10000;
+
+static void printUsage()
+{
+    std::cerr <<
+              "usage: TerrainBench [options]\n"
+              "  -f, --filter <text>      only cases whose name contains text\n"
+              "  -t, --min-time <s>       seconds every case runs at least (0.5)\n"
+              "  --max-size <size>        largest noise map and lightmap (4096)\n"
+              "  -o, --output <file>      json destination (standard output)\n";
+}
+
+static bool parseOptions(int argc, char * argv[], Options &options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if((argument == "-f" || argument == "--filter") && hasValue)
+        {
+            options.filter = argv[++i];
+        }
+        else if((argument == "-t" || argument == "--min-time") && hasValue)
+        {
+            options.minTime = std::atof(argv[++i]);
+        }
+        else if(argument == "--max-size" && hasValue)
+        {
+            options.maxSize = std::atoi(argv[++i]);
+        }
+        else if((argument == "-o" || argument == "--output") && hasValue)
+        {
+            options.output = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return options.minTime >= 0.0 && options.maxSize >= 256;
+}
+
+static bool wanted(const Options &options, const std::string &name)
+{
+    return name.find(options.filter) != std::string::npos;
+}
+
+// runs body until minTime has passed, the first run only warms up caches
+// and the job system unless it alone takes longer than minTime
+static void measure(const Options &options, std::vector<Result> &results,
+                    const std::string &name, double items, const char * itemName,
+                    const std::function<void()> &body)
+{
+    if(!wanted(options, name)) return;
+
+    typedef std::chrono::steady_clock Clock;
+    auto timed = [&body]() -> double
+    {
+        Clock::time_point start = Clock::now();
+        body();
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    const double minTime = options.minTime * 1000.0;
+    double first = timed();
+    Result result;
+    result.name = name;
+    result.iterations = 0;
+    result.meanTime = 0.0;
+    result.fastestTime = std::numeric_limits<double>::max();
+    result.items = items;
+    result.itemName = itemName;
+    double total = 0.0;
+
+    if(first >= minTime)
+    {
+        result.iterations = 1;
+        total = result.fastestTime = first;
+    }
+
+    while(total < minTime && result.iterations < MaxIterations)
+    {
+        double elapsed = timed();
+        total += elapsed;
+        result.fastestTime = std::min(result.fastestTime, elapsed);
+        result.iterations++;
+    }
+
+    result.meanTime = total / result.iterations;
+    results.push_back(result);
+    std::fprintf(stderr, "%-40s %8d %12.3f ms %14.0f %s/s\n", name.c_str(),
+                 result.iterations, result.meanTime,
+                 items / (result.meanTime / 1000.0), itemName);
+}
+
+// one module at a time on a single thread over a square of points
+static void noiseModuleCases(const Options &options, std::vector<Result> &results)
+{
+    const int side = 256;
+    // same parameters the heightmap graph uses
+    module::Perlin perlin;
+    perlin.SetFrequency(0.5);
+    perlin.SetPersistence(0.25);
+    module::Billow billow;
+    billow.SetFrequency(1.75);
+    module::RidgedMulti ridgedMulti;
+    ridgedMulti.SetFrequency(0.65);
+    module::ScaleBias scaleBias;
+    scaleBias.SetSourceModule(0, billow);
+    scaleBias.SetScale(0.075);
+    scaleBias.SetBias(-0.65);
+    module::Invert invert;
+    invert.SetSourceModule(0, billow);
+    module::Multiply multiply;
+    multiply.SetSourceModule(0, billow);
+    multiply.SetSourceModule(1, perlin);
+    module::Select select;
+    select.SetSourceModule(0, billow);
+    select.SetSourceModule(1, ridgedMulti);
+    select.SetControlModule(perlin);
+    select.SetBounds(-0.15, 35.0);
+    select.SetEdgeFalloff(0.35);
+    module::Turbulence turbulence;
+    turbulence.SetSourceModule(0, perlin);
+    turbulence.SetFrequency(4.0);
+    turbulence.SetPower(0.125);
+    const std::pair<const char *, const module::Module *> modules[] =
+    {
+        std::make_pair("perlin", &perlin),
+        std::make_pair("billow", &billow),
+        std::make_pair("ridged_multi", &ridgedMulti),
+        std::make_pair("scale_bias", &scaleBias),
+        std::make_pair("invert", &invert),
+        std::make_pair("multiply", &multiply),
+        std::make_pair("select", &select),
+        std::make_pair("turbulence", &turbulence)
+    };
+
+    for(auto &entry : modules)
+    {
+        const module::Module &source = *entry.second;
+        // keeps the values alive so the calls aren't optimized away
+        volatile double sink = 0.0;
+        measure(options, results, std::string("noise/module/") + entry.first,
+                side * side, "points", [&]()
+        {
+            double sum = 0.0;
+
+            for(int z = 0; z < side; z++)
+            {
+                for(int x = 0; x < side; x++)
+                {
+                    sum += source.GetValue(x * 5.0 / side, 0.0, z * 5.0 / side);
+                }
+            }
+
+            sink = sum;
+        });
+    }
+}
+
+// the libnoise plane builder on a single thread and the whole heightmap
+// graph built in parallel by Heightmap
+static void noiseMapCases(const Options &options, std::vector<Result> &results)
+{
+    module::Perlin perlin;
+    utils::NoiseMap noiseMap;
+    utils::NoiseMapBuilderPlane builder;
+    builder.SetSourceModule(perlin);
+    builder.SetDestNoiseMap(noiseMap);
+    builder.SetBounds(0.0, 5.0, 0.0, 5.0);
+
+    for(int size = 256; size <= options.maxSize; size *= 2)
+    {
+        measure(options, results, "noise/builder_plane/" + std::to_string(size),
+                (double)size * size, "points", [&]()
+        {
+            builder.SetDestSize(size, size);
+            builder.Build();
+        });
+    }
+
+    Heightmap heightmap;
+
+    for(int size = 256; size <= options.maxSize; size *= 2)
+    {
+        measure(options, results, "noise/heightmap_graph/" + std::to_string(size),
+                (double)size * size, "points", [&]()
+        {
+            heightmap.setSize(size, size);
+            heightmap.build();
+        });
+    }
+}
+
+// what createMesh and generateChunks do on the cpu, from the 1024
+// heightmap the renderer builds at its largest usual size
+static void meshCases(const Options &options, std::vector<Result> &results)
+{
+    const int meshExponents[] = { 8, 9, 10 };
+    bool any = false;
+
+    for(int exponent : meshExponents)
+    {
+        std::string size = std::to_string(exponent);
+        any = any || wanted(options, "mesh/build/" + size)
+              || wanted(options, "chunks/bounds/" + size)
+              || wanted(options, "chunks/lod_indices/" + size)
+              || wanted(options, "chunks/height_changes/" + size);
+    }
+
+    if(!any) return;
+
+    Heightmap heightmap;
+    heightmap.setSize(1024, 1024);
+    heightmap.build();
+    const int chunkExponent = TerrainMeshBuilder::ChunkSizeExponent;
+    const int chunkSize = (1 << chunkExponent) + 1;
+
+    for(int exponent : meshExponents)
+    {
+        std::string size = std::to_string(exponent);
+        const int meshSize = (1 << exponent) + 1;
+        const int chunkCount = (meshSize - 1) / (chunkSize - 1);
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> texCoords;
+        std::vector<unsigned int> indices;
+        measure(options, results, "mesh/build/" + size, (double)meshSize * meshSize,
+                "vertices", [&]()
+        {
+            TerrainMeshBuilder::buildMesh(heightmap, exponent, vertices, normals,
+                                          texCoords, indices);
+        });
+
+        if(vertices.empty())
+        {
+            TerrainMeshBuilder::buildMesh(heightmap, exponent, vertices, normals,
+                                          texCoords, indices);
+        }
+
+        std::vector<TerrainSnapshot::ChunkBounds> bounds;
+        measure(options, results, "chunks/bounds/" + size,
+                (double)chunkCount * chunkCount, "chunks", [&]()
+        {
+            TerrainMeshBuilder::buildChunkBounds(vertices, exponent, chunkExponent,
+                                                 bounds);
+        });
+        std::array<std::vector<unsigned int>, 3> lodIndices;
+        measure(options, results, "chunks/lod_indices/" + size,
+                (double)chunkCount * chunkCount, "chunks", [&]()
+        {
+            TerrainMeshBuilder::buildLoDIndices(meshSize, chunkSize, lodIndices);
+        });
+
+        // every chunk error on a single thread, as TerrainChunk did it
+        if(!wanted(options, "chunks/height_changes/" + size)) continue;
+
+        std::vector<std::vector<glm::vec3>> chunkVertices(chunkCount * chunkCount);
+
+        for(int index = 0; index < chunkCount * chunkCount; index++)
+        {
+            int x = index % chunkCount;
+            int y = index / chunkCount;
+
+            for(int i = 0; i < chunkSize; i++)
+            {
+                for(int j = 0; j < chunkSize; j++)
+                {
+                    chunkVertices[index].push_back(vertices[(i + y * (chunkSize - 1)) * meshSize
+                                                   + j + x * (chunkSize - 1)]);
+                }
+            }
+        }
+
+        measure(options, results, "chunks/height_changes/" + size,
+                (double)chunkCount * chunkCount, "chunks", [&]()
+        {
+            float heightChange[2];
+
+            for(auto &chunk : chunkVertices)
+            {
+                TerrainMeshBuilder::chunkHeightChanges(chunk, chunkSize, heightChange);
+            }
+        });
+    }
+}
+
+// the batched culler against the single box test Camera::isBoxInFrustum
+// runs, boxes spread around a camera looking over the terrain
+static void cullingCases(const Options &options, std::vector<Result> &results)
+{
+    const int boxCounts[] = { 4096, 65536 };
+    glm::vec4 planes[6];
+    const glm::vec3 eye(0.0f, 20.0f, 0.0f);
+    FrustumCuller::extractPlanes(
+        glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f) *
+        glm::lookAt(eye, glm::vec3(100.0f, 0.0f, 100.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+        planes);
+    const glm::mat4 model(1.0f);
+
+    for(int count : boxCounts)
+    {
+        std::string size = std::to_string(count);
+
+        if(!wanted(options, "culling/frustum/" + size)
+           && !wanted(options, "culling/box_in_frustum/" + size)) continue;
+
+        // a square grid of chunk sized boxes with varying heights
+        const int side = (int)std::sqrt((double)count);
+        std::vector<glm::vec3> centers(count);
+        std::vector<glm::vec3> halfDims(count);
+        FrustumCuller culler;
+        culler.resize(count);
+
+        for(int i = 0; i < count; i++)
+        {
+            float x = (i % side - side / 2) * 8.0f;
+            float z = (i / side - side / 2) * 8.0f;
+            float height = 2.0f + 2.0f * std::sin(x * 0.05f) * std::cos(z * 0.03f);
+            centers[i] = glm::vec3(x, height / 2.0f, z);
+            halfDims[i] = glm::vec3(4.0f, height / 2.0f, 4.0f);
+            culler.setBox(i, centers[i], halfDims[i] * 2.0f);
+        }
+
+        measure(options, results, "culling/frustum/" + size, count, "boxes", [&]()
+        {
+            culler.cull(planes, model, eye, true);
+        });
+        volatile int sink = 0;
+        measure(options, results, "culling/box_in_frustum/" + size, count, "boxes",
+                [&]()
+        {
+            int visible = 0;
+
+            for(int i = 0; i < count; i++)
+            {
+                visible += FrustumCuller::testBox(planes, centers[i], halfDims[i]) != 0;
+            }
+
+            sink = visible;
+        });
+    }
+}
+
+// time of the day lightmaps at a high, a medium and a grazing sun, the
+// last one has the longest shadow marches
+static void shadowCases(const Options &options, std::vector<Result> &results)
+{
+    const int lightmapSizes[] = { 1024, 2048 };
+    const std::pair<const char *, float> sunTimes[] =
+    {
+        std::make_pair("noon", 0.0f),
+        std::make_pair("afternoon", 1.2f),
+        std::make_pair("dusk", 2.1f)
+    };
+    bool any = false;
+
+    for(int size : lightmapSizes)
+    {
+        if(size > options.maxSize) continue;
+
+        std::string sizeName = std::to_string(size);
+        any = any || wanted(options, "shadows/resample/" + sizeName);
+
+        for(auto &sun : sunTimes)
+        {
+            any = any || wanted(options, "shadows/ray_march/" + sizeName + "/" + sun.first)
+                  || wanted(options, "shadows/sweep/" + sizeName + "/" + sun.first);
+        }
+    }
+
+    if(!any) return;
+
+    // clamped heights as the renderer bakes from
+    const int resolution = 1024;
+    Heightmap heightmap;
+    heightmap.setSize(resolution, resolution);
+    heightmap.build();
+    std::vector<float> values(resolution * resolution);
+
+    for(int y = 0; y < resolution; y++)
+    {
+        for(int x = 0; x < resolution; x++)
+        {
+            values[y * resolution + x] = std::min(std::max(heightmap.getValue(x, y),
+                                                  0.0f), 1.0f);
+        }
+    }
+
+    for(int size : lightmapSizes)
+    {
+        if(size > options.maxSize) continue;
+
+        std::string sizeName = std::to_string(size);
+        std::vector<float> heights;
+        unsigned int rowStride = 0;
+        measure(options, results, "shadows/resample/" + sizeName,
+                (double)size * size, "texels", [&]()
+        {
+            rowStride = ShadowmapBaker::resampleShadowHeights(values.data(), resolution,
+                        size, heights);
+        });
+
+        if(heights.empty())
+        {
+            rowStride = ShadowmapBaker::resampleShadowHeights(values.data(), resolution,
+                        size, heights);
+        }
+
+        std::vector<unsigned char> lightmap;
+
+        for(auto &sun : sunTimes)
+        {
+            glm::vec3 lightDir = ShadowmapBaker::lightDirection(sun.second);
+            measure(options, results, "shadows/ray_march/" + sizeName + "/" + sun.first,
+                    (double)size * size, "texels", [&]()
+            {
+                ShadowmapBaker::fastGenerateShadowmapParallel(lightDir, lightmap, size,
+                        heights, rowStride, nullptr);
+            });
+            measure(options, results, "shadows/sweep/" + sizeName + "/" + sun.first,
+                    (double)size * size, "texels", [&]()
+            {
+                ShadowmapBaker::sweepGenerateShadowmapParallel(lightDir, lightmap, size,
+                        heights, rowStride, nullptr);
+            });
+        }
+    }
+}
+
+// reads a byte of every page so the mapping is faulted in as the gl
+// uploads would do it
+static unsigned int touchPages(const unsigned char * data, size_t size)
+{
+    unsigned int sum = 0;
+
+    for(size_t i = 0; i < size; i += 4096)
+    {
+        sum += data[i];
+    }
+
+    return sum;
+}
+
+// the gl free part of loading a terrain snapshot against generating the
+// same terrain again, both with the cpu stages of heightmapChanged. the
+// snapshot is read back from the page cache
+static void snapshotCases(const Options &options, std::vector<Result> &results)
+{
+    const int sizeExponents[] = { 10, 11 };
+
+    for(int exponent : sizeExponents)
+    {
+        const int resolution = 1 << exponent;
+        std::string size = std::to_string(resolution);
+
+        if(resolution > options.maxSize
+           || (!wanted(options, "snapshot/regenerate/" + size)
+               && !wanted(options, "snapshot/load/" + size))) continue;
+
+        const int chunkExponent = TerrainMeshBuilder::ChunkSizeExponent;
+        const int meshSize = (1 << exponent) + 1;
+        Heightmap heightmap;
+        std::vector<float> clampedHeights(resolution * resolution);
+        std::uint64_t heightHash = 0;
+        std::vector<float> meshHeights(resolution * resolution);
+        std::vector<short> normalMap;
+        const void * heightTexels = nullptr;
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> texCoords;
+        std::vector<unsigned int> indices;
+        std::vector<glm::vec3> chunkVertices;
+        std::vector<glm::vec3> chunkNormals;
+        std::vector<glm::vec2> chunkTexCoords;
+        std::vector<TerrainSnapshot::ChunkBounds> bounds;
+        std::array<std::vector<unsigned int>, 3> lodIndices;
+        // clamped copy heightmapChanged hands to the bake jobs
+        auto copyClamped = [&]()
+        {
+            Parallel::forEach(0, resolution, [&](int y)
+            {
+                for(int x = 0; x < resolution; x++)
+                {
+                    clampedHeights[y * resolution + x] =
+                        std::min(std::max(heightmap.getValue(x, y), 0.0f), 1.0f);
+                }
+            });
+        };
+        // what createTerrain and createMesh do before any gl call, the
+        // heightmapChanged jobs overlap as they do there
+        auto regenerate = [&]()
+        {
+            heightmap.setSize(resolution, resolution);
+            heightmap.build();
+            JobSystem::JobHandle hashJob = JobSystem::run([&]()
+            {
+                copyClamped();
+                heightHash = BakeCache::hash(clampedHeights.data(),
+                                             clampedHeights.size() * sizeof(float));
+            });
+            JobSystem::JobHandle normalsJob = JobSystem::run([&]()
+            {
+                Parallel::forEach(0, resolution, [&](int y)
+                {
+                    for(int x = 0; x < resolution; x++)
+                    {
+                        meshHeights[y * resolution + x] =
+                            TerrainMeshBuilder::vertexHeight(heightmap, x, y);
+                    }
+                });
+                TerrainMapBaker::bakeNormalMap(meshHeights.data(), resolution, normalMap);
+            });
+            heightTexels = heightmap.RawImage();
+            JobSystem::wait(hashJob);
+            JobSystem::wait(normalsJob);
+            TerrainMeshBuilder::buildMesh(heightmap, exponent, vertices, normals,
+                                          texCoords, indices);
+            TerrainMeshBuilder::buildChunkVertices(vertices, normals, texCoords, exponent,
+                                                   chunkExponent, chunkVertices,
+                                                   chunkNormals, chunkTexCoords);
+            TerrainMeshBuilder::buildChunkBounds(vertices, exponent, chunkExponent,
+                                                 bounds);
+            TerrainMeshBuilder::buildLoDIndices(meshSize, (1 << chunkExponent) + 1,
+                                                lodIndices);
+        };
+        measure(options, results, "snapshot/regenerate/" + size,
+                (double)resolution * resolution, "points", regenerate);
+
+        if(!wanted(options, "snapshot/load/" + size)) continue;
+
+        if(vertices.empty()) regenerate();
+
+        std::vector<float> heights(resolution * resolution);
+
+        for(int y = 0; y < resolution; y++)
+        {
+            for(int x = 0; x < resolution; x++)
+            {
+                heights[y * resolution + x] = heightmap.getValue(x, y);
+            }
+        }
+
+        TerrainSnapshot::Description description;
+        std::memset(&description, 0, sizeof(description));
+        description.terrainResolution = resolution;
+        description.meshSizeExponent = exponent;
+        description.chunkSizeExponent = chunkExponent;
+        description.heightHash = heightHash;
+        const void * sections[TerrainSnapshot::SectionCount] =
+        {
+            heights.data(), heightTexels, meshHeights.data(), normalMap.data(),
+            vertices.data(), normals.data(), texCoords.data(), indices.data(),
+            chunkVertices.data(), chunkNormals.data(), chunkTexCoords.data(),
+            bounds.data(), lodIndices[0].data(), lodIndices[1].data(),
+            lodIndices[2].data(), nullptr
+        };
+        std::string filename = "TerrainBench" + size + TerrainSnapshot::extension;
+
+        if(!TerrainSnapshot::write(filename, description, sections))
+        {
+            std::cerr << "TerrainBench: couldn't write " << filename << std::endl;
+            continue;
+        }
+
+        volatile unsigned int sink = 0;
+        measure(options, results, "snapshot/load/" + size,
+                (double)resolution * resolution, "points", [&]()
+        {
+            TerrainSnapshot snapshot;
+
+            if(!snapshot.open(filename)) return;
+
+            // same copies loadSnapshot and heightmapChanged make, everything
+            // else is uploaded straight from the mapping
+            heightmap.load((const float *)snapshot.SectionData(TerrainSnapshot::Heights),
+                           resolution, resolution);
+            copyClamped();
+            const float * storedHeights = (const float *)snapshot.SectionData(
+                                              TerrainSnapshot::MeshHeights);
+            meshHeights.assign(storedHeights, storedHeights + meshHeights.size());
+            unsigned int sum = 0;
+
+            for(int i = TerrainSnapshot::HeightTexels; i < TerrainSnapshot::Lightmaps; i++)
+            {
+                if(i == TerrainSnapshot::MeshHeights) continue;
+
+                TerrainSnapshot::Section section = (TerrainSnapshot::Section)i;
+                sum += touchPages(snapshot.SectionData(section), snapshot.SectionSize(section));
+            }
+
+            sink = sum;
+        });
+        std::remove(filename.c_str());
+    }
+}
+
+static void writeJson(std::ostream &out, const Options &options,
+                      const std::vector<Result> &results)
+{
+    out << "{\n  \"context\": {\n"
+        << "    \"threads\": " << Parallel::ThreadCount() << ",\n"
+        << "    \"min_time_s\": " << options.minTime << ",\n"
+        << "    \"max_size\": " << options.maxSize << "\n  },\n"
+        << "  \"benchmarks\": [";
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const Result &result = results[i];
+        // names never hold characters json needs escaped
+        out << (i > 0 ? "," : "") << "\n    {"
+            << "\"name\": \"" << result.name << "\", "
+            << "\"iterations\": " << result.iterations << ", "
+            << "\"mean_ms\": " << result.meanTime << ", "
+            << "\"min_ms\": " << result.fastestTime << ", "
+            << "\"items_per_second\": " << result.items / (result.meanTime / 1000.0) << ", "
+            << "\"item\": \"" << result.itemName << "\"}";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+
+    if(!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<Result> results;
+    noiseModuleCases(options, results);
+    noiseMapCases(options, results);
+    meshCases(options, results);
+    cullingCases(options, results);
+    shadowCases(options, results);
+    snapshotCases(options, results);
+
+    if(options.output.empty())
+    {
+        writeJson(std::cout, options, results);
+        return 0;
+    }
+
+    std::ofstream file(options.output.c_str());
+
+    if(!file)
+    {
+        std::cerr << "TerrainBench: couldn't write " << options.output << std::endl;
+        return 2;
+    }
+
+    writeJson(file, options, results);
+    return 0;
+}
+
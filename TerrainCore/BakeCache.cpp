@@ -0,0 +1,81 @@
+#include "Commons.h"
+#include "BakeCache.h"
+
+const char * BakeCache::directory = "BakeCache";
+
+std::string BakeCache::entryPath(std::uint64_t key)
+{
+    std::stringstream path;
+    path << directory << "/" << std::hex << key << ".bake";
+    return path.str();
+}
+
+std::uint64_t BakeCache::hash(const void * data, size_t size,
+                              std::uint64_t seed)
+{
+    const unsigned char * bytes = (const unsigned char *)data;
+    std::uint64_t value = seed;
+
+    for(size_t i = 0; i < size; i++)
+    {
+        value ^= bytes[i];
+        value *= 1099511628211ull;
+    }
+
+    return value;
+}
+
+bool BakeCache::load(std::uint64_t key, EntryKind kind, int width, int height,
+                     int depth, size_t texelsSize, MappedFile &file,
+                     const unsigned char *&texels)
+{
+    if(!file.open(entryPath(key))) return false;
+
+    if(file.Size() < sizeof(EntryHeader) + texelsSize)
+    {
+        file.close();
+        return false;
+    }
+
+    EntryHeader header;
+    std::memcpy(&header, file.Data(), sizeof(EntryHeader));
+
+    // a stale or colliding entry is treated as missing
+    if(std::memcmp(header.magic, "TBKC", 4) != 0
+       || header.version != version
+       || header.kind != (std::uint32_t)kind
+       || header.width != (std::uint32_t)width
+       || header.height != (std::uint32_t)height
+       || header.depth != (std::uint32_t)depth
+       || header.key != key)
+    {
+        file.close();
+        return false;
+    }
+
+    texels = file.Data() + sizeof(EntryHeader);
+    return true;
+}
+
+bool BakeCache::store(std::uint64_t key, EntryKind kind, int width, int height,
+                      int depth, const unsigned char * texels, size_t texelsSize)
+{
+#ifdef _WIN32
+    CreateDirectoryA(directory, NULL);
+#else
+    mkdir(directory, 0755);
+#endif
+    EntryHeader header;
+    std::memcpy(header.magic, "TBKC", 4);
+    header.version = version;
+    header.kind = kind;
+    header.width = width;
+    header.height = height;
+    header.depth = depth;
+    header.key = key;
+    return MappedFile::replace(entryPath(key), [&](std::ostream & output)
+    {
+        output.write((const char *)&header, sizeof(EntryHeader));
+        output.write((const char *)texels, texelsSize);
+    });
+}
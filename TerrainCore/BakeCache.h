@@ -0,0 +1,42 @@
+#pragma once
+#include "MappedFile.h"
+
+// baked texture data stored on disk, entries are keyed by a
+// hash of everything that went into the bake
+class BakeCache
+{
+    public:
+        enum EntryKind
+        {
+            TimeOfTheDayLightmaps = 1,
+            HorizonMap
+        };
+    private:
+        static const char * directory;
+        // bump when the baked data layout changes
+        static const std::uint32_t version = 3;
+        struct EntryHeader
+        {
+            char magic[4];
+            std::uint32_t version;
+            std::uint32_t kind;
+            std::uint32_t width;
+            std::uint32_t height;
+            std::uint32_t depth;
+            std::uint64_t key;
+        };
+        static std::string entryPath(std::uint64_t key);
+    public:
+        // 64 bit fnv-1a, pass a previous hash as seed to chain data
+        static std::uint64_t hash(const void * data, size_t size,
+                                  std::uint64_t seed = 14695981039346656037ull);
+        // maps the entry for key into file, texels points to texelsSize bytes
+        // of mapped data. false if missing or its layout doesn't match
+        static bool load(std::uint64_t key, EntryKind kind, int width, int height,
+                         int depth, size_t texelsSize, MappedFile &file,
+                         const unsigned char *&texels);
+        // writes an entry, texelsSize is width * height * depth * texel size
+        static bool store(std::uint64_t key, EntryKind kind, int width, int height,
+                          int depth, const unsigned char * texels, size_t texelsSize);
+};
+
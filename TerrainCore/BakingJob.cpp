@@ -0,0 +1,59 @@
+#include "Commons.h"
+#include "BakingJob.h"
+
+void BakingJob::start(int steps, std::function<void(BakingJob &)> work)
+{
+    cancel();
+    cancelRequested = false;
+    completedSteps = 0;
+    totalSteps = std::max(1, steps);
+    state = InProgress;
+    job = JobSystem::run([this, work]()
+    {
+        // cancelled while still queued
+        if(cancelRequested)
+        {
+            state = Cancelled;
+            return;
+        }
+
+        work(*this);
+        state = cancelRequested ? Cancelled : Finished;
+    }, JobSystem::Background);
+}
+
+void BakingJob::cancel()
+{
+    if(!job) return;
+
+    cancelRequested = true;
+    // a job that hasn't started yet returns right away on this thread,
+    // never waits behind other queued background work
+    JobSystem::wait(job);
+    job.reset();
+    state = Cancelled;
+}
+
+bool BakingJob::collect()
+{
+    if(state != Finished) return false;
+
+    job.reset();
+    state = Idle;
+    return true;
+}
+
+float BakingJob::Progress() const
+{
+    return std::min(1.0f, (float)completedSteps / totalSteps);
+}
+
+BakingJob::BakingJob() : state(Idle), cancelRequested(false),
+    completedSteps(0), totalSteps(1)
+{
+}
+
+BakingJob::~BakingJob()
+{
+    cancel();
+}
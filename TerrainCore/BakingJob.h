@@ -0,0 +1,43 @@
+#pragma once
+#include "JobSystem.h"
+
+class BakingJob
+{
+    public:
+        enum JobState
+        {
+            Idle = 0,
+            InProgress,
+            // work returned normally, waiting to be collected
+            Finished,
+            Cancelled
+        };
+    private:
+        // background job running the work
+        JobSystem::JobHandle job;
+        std::atomic<int> state;
+        std::atomic<bool> cancelRequested;
+        // progress reported by the work function
+        std::atomic<int> completedSteps;
+        int totalSteps;
+    public:
+        // cancels the current work and runs work as a background job,
+        // work has to poll CancelRequested and report its steps with advance
+        void start(int steps, std::function<void(BakingJob &)> work);
+        // requests cancellation and waits until the work returns
+        void cancel();
+        // releases a finished job, true once per finished run
+        bool collect();
+        // called from the work function
+        void advance(int steps = 1) { completedSteps += steps; }
+
+        bool CancelRequested() const { return cancelRequested; }
+        JobState State() const { return JobState(state.load()); }
+        bool Running() const { return state == InProgress; }
+        // completed fraction 0..1
+        float Progress() const;
+
+        BakingJob();
+        ~BakingJob();
+};
+
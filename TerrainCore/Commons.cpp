@@ -0,0 +1 @@
+#include "Commons.h"
\ No newline at end of file
@@ -0,0 +1,50 @@
+// shared by the renderer and the command line tools, nothing here
+// may need a window or an opengl context
+// os specific includes
+#ifdef _WIN32
+#include <windows.h>
+#else
+// memory mapped files
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+// pre-processors
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_PURE
+#define _USE_MATH_DEFINES
+// coherent noise generation
+#include <noise/noise.h>
+#include "noise/interp.h"
+#include <noiseutils.h>
+// standard and stl library headers
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <math.h>
+// sse intrinsics for batched math
+#include <emmintrin.h>
+// glm math library headers
+#include <glm/glm.hpp>
+#include <glm/common.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtx/norm.hpp>
+#include <glm/gtx/compatibility.hpp>
@@ -0,0 +1,288 @@
+#include "Commons.h"
+#include "FrustumCuller.h"
+
+// corners of a unit box indexed by vectorToIndex
+static const glm::vec3 cornerOffsets[] =
+{
+    glm::vec3(-1.f, -1.f, -1.f),
+    glm::vec3(-1.f, -1.f, 1.f),
+    glm::vec3(-1.f, 1.f, -1.f),
+    glm::vec3(-1.f, 1.f, 1.f),
+    glm::vec3(1.f, -1.f, -1.f),
+    glm::vec3(1.f, -1.f, 1.f),
+    glm::vec3(1.f, 1.f, -1.f),
+    glm::vec3(1.f, 1.f, 1.f)
+};
+
+int FrustumCuller::vectorToIndex(const glm::vec3 &v)
+{
+    int idx = 0;
+
+    if(v.z >= 0) idx |= 1;
+
+    if(v.y >= 0) idx |= 2;
+
+    if(v.x >= 0) idx |= 4;
+
+    return idx;
+}
+
+int FrustumCuller::halfPlaneTest(const glm::vec3 &p, const glm::vec3 &normal,
+                                 float offset)
+{
+    float dist = glm::dot(p, normal) + offset;
+
+    if(dist > 0.02)  // Point is in front of plane
+        return 1;
+    else if(dist < -0.02)  // Point is behind plane
+        return 0;
+
+    return 2; // Point is on plane
+}
+
+void FrustumCuller::extractPlanes(const glm::mat4 &matrix, glm::vec4 planes[6])
+{
+    // Extract frustum planes from matrix
+    // Planes are in format: normal(xyz), offset(w)
+    // right
+    planes[0] = glm::vec4(matrix[0][3] - matrix[0][0],
+                          matrix[1][3] - matrix[1][0],
+                          matrix[2][3] - matrix[2][0],
+                          matrix[3][3] - matrix[3][0]);
+    // left
+    planes[1] = glm::vec4(matrix[0][3] + matrix[0][0],
+                          matrix[1][3] + matrix[1][0],
+                          matrix[2][3] + matrix[2][0],
+                          matrix[3][3] + matrix[3][0]);
+    // bottom
+    planes[2] = glm::vec4(matrix[0][3] + matrix[0][1],
+                          matrix[1][3] + matrix[1][1],
+                          matrix[2][3] + matrix[2][1],
+                          matrix[3][3] + matrix[3][1]);
+    // top
+    planes[3] = glm::vec4(matrix[0][3] - matrix[0][1],
+                          matrix[1][3] - matrix[1][1],
+                          matrix[2][3] - matrix[2][1],
+                          matrix[3][3] - matrix[3][1]);
+    // far
+    planes[4] = glm::vec4(matrix[0][3] - matrix[0][2],
+                          matrix[1][3] - matrix[1][2],
+                          matrix[2][3] - matrix[2][2],
+                          matrix[3][3] - matrix[3][2]);
+    // near
+    planes[5] = glm::vec4(matrix[0][3] + matrix[0][2],
+                          matrix[1][3] + matrix[1][2],
+                          matrix[2][3] + matrix[2][2],
+                          matrix[3][3] + matrix[3][2]);
+
+    // Normalize them
+    for(int i = 0; i < 6; i++)
+    {
+        float invl = sqrt(planes[i].x * planes[i].x +
+                          planes[i].y * planes[i].y +
+                          planes[i].z * planes[i].z);
+        planes[i] /= invl;
+    }
+}
+
+int FrustumCuller::testBox(const glm::vec4 * planes, const glm::vec3 &origin,
+                           const glm::vec3 &halfDim)
+{
+    int ret = 1;
+
+    for(int i = 0; i < 6; i++)
+    {
+        glm::vec3 planeNormal = glm::vec3(planes[i]);
+        int idx = vectorToIndex(planeNormal);
+        // Test the farthest point of the box from the plane
+        // if it's behind the plane, then the entire box will be.
+        glm::vec3 testPoint = origin + halfDim * cornerOffsets[idx];
+
+        if(halfPlaneTest(testPoint, planeNormal, planes[i].w) == 0)
+        {
+            ret = 0;
+            break;
+        }
+
+        // Now, test the closest point to the plane
+        // If it's behind the plane, then the box is partially inside, otherwise it is entirely inside.
+        idx = vectorToIndex(-planeNormal);
+        testPoint = origin + halfDim * cornerOffsets[idx];
+
+        if(halfPlaneTest(testPoint, planeNormal, planes[i].w) == 0)
+        {
+            ret |= 2;
+        }
+    }
+
+    return ret;
+}
+
+void FrustumCuller::resize(unsigned int count)
+{
+    unsigned int padded = (count + SIMDWidth - 1) / SIMDWidth * SIMDWidth;
+    this->boxCount = count;
+    // padding boxes are never reported as visible
+    centerX.assign(padded, 0.0f);
+    centerY.assign(padded, 0.0f);
+    centerZ.assign(padded, 0.0f);
+    extentX.assign(padded, 0.0f);
+    extentY.assign(padded, 0.0f);
+    extentZ.assign(padded, 0.0f);
+    visible.reserve(count);
+    distances.reserve(count);
+}
+
+void FrustumCuller::setBox(unsigned int index, const glm::vec3 &center,
+                           const glm::vec3 &dimension)
+{
+    if(index >= boxCount) return;
+
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = dimension.x / 2.0f;
+    extentY[index] = dimension.y / 2.0f;
+    extentZ[index] = dimension.z / 2.0f;
+}
+
+void FrustumCuller::cull(const glm::vec4 * planes, const glm::mat4 &model,
+                         const glm::vec3 &eye, bool testPlanes)
+{
+    visible.clear();
+    distances.clear();
+
+    if(boxCount == 0) return;
+
+    // affine part of the model matrix, glm matrices are column major
+    const __m128 m00 = _mm_set1_ps(model[0][0]), m10 = _mm_set1_ps(model[1][0]),
+                 m20 = _mm_set1_ps(model[2][0]), m30 = _mm_set1_ps(model[3][0]);
+    const __m128 m01 = _mm_set1_ps(model[0][1]), m11 = _mm_set1_ps(model[1][1]),
+                 m21 = _mm_set1_ps(model[2][1]), m31 = _mm_set1_ps(model[3][1]);
+    const __m128 m02 = _mm_set1_ps(model[0][2]), m12 = _mm_set1_ps(model[1][2]),
+                 m22 = _mm_set1_ps(model[2][2]), m32 = _mm_set1_ps(model[3][2]);
+    // absolute values transform the extents into a world space aabb
+    const __m128 a00 = _mm_set1_ps(std::abs(model[0][0])),
+                 a10 = _mm_set1_ps(std::abs(model[1][0])),
+                 a20 = _mm_set1_ps(std::abs(model[2][0]));
+    const __m128 a01 = _mm_set1_ps(std::abs(model[0][1])),
+                 a11 = _mm_set1_ps(std::abs(model[1][1])),
+                 a21 = _mm_set1_ps(std::abs(model[2][1]));
+    const __m128 a02 = _mm_set1_ps(std::abs(model[0][2])),
+                 a12 = _mm_set1_ps(std::abs(model[1][2])),
+                 a22 = _mm_set1_ps(std::abs(model[2][2]));
+    const __m128 eyeX = _mm_set1_ps(eye.x);
+    const __m128 eyeY = _mm_set1_ps(eye.y);
+    const __m128 eyeZ = _mm_set1_ps(eye.z);
+    // same tolerance as halfPlaneTest
+    const __m128 epsilon = _mm_set1_ps(-0.02f);
+    // broadcast the planes once, normal(xyz) offset(w)
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m128 planeAbsX[6], planeAbsY[6], planeAbsZ[6];
+
+    for(int i = 0; i < 6; i++)
+    {
+        planeX[i] = _mm_set1_ps(planes[i].x);
+        planeY[i] = _mm_set1_ps(planes[i].y);
+        planeZ[i] = _mm_set1_ps(planes[i].z);
+        planeW[i] = _mm_set1_ps(planes[i].w);
+        planeAbsX[i] = _mm_set1_ps(std::abs(planes[i].x));
+        planeAbsY[i] = _mm_set1_ps(std::abs(planes[i].y));
+        planeAbsZ[i] = _mm_set1_ps(std::abs(planes[i].z));
+    }
+
+    const unsigned int padded = (unsigned int)centerX.size();
+
+    for(unsigned int i = 0; i < padded; i += SIMDWidth)
+    {
+        __m128 cx = _mm_loadu_ps(&centerX[i]);
+        __m128 cy = _mm_loadu_ps(&centerY[i]);
+        __m128 cz = _mm_loadu_ps(&centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&extentX[i]);
+        __m128 ey = _mm_loadu_ps(&extentY[i]);
+        __m128 ez = _mm_loadu_ps(&extentZ[i]);
+        // world space centers
+        __m128 wx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, cx), _mm_mul_ps(m10, cy)),
+                               _mm_add_ps(_mm_mul_ps(m20, cz), m30));
+        __m128 wy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, cx), _mm_mul_ps(m11, cy)),
+                               _mm_add_ps(_mm_mul_ps(m21, cz), m31));
+        __m128 wz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, cx), _mm_mul_ps(m12, cy)),
+                               _mm_add_ps(_mm_mul_ps(m22, cz), m32));
+        // all lanes inside by default
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        if(testPlanes)
+        {
+            // world space half dimensions
+            __m128 hx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a00, ex), _mm_mul_ps(a10, ey)),
+                                   _mm_mul_ps(a20, ez));
+            __m128 hy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a01, ex), _mm_mul_ps(a11, ey)),
+                                   _mm_mul_ps(a21, ez));
+            __m128 hz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a02, ex), _mm_mul_ps(a12, ey)),
+                                   _mm_mul_ps(a22, ez));
+
+            for(int p = 0; p < 6; p++)
+            {
+                // signed distance of the center plus the projected radius
+                // gives the distance of the farthest corner along the normal
+                __m128 distance = _mm_add_ps(
+                                      _mm_add_ps(_mm_mul_ps(planeX[p], wx), _mm_mul_ps(planeY[p], wy)),
+                                      _mm_add_ps(_mm_mul_ps(planeZ[p], wz), planeW[p]));
+                __m128 radius = _mm_add_ps(
+                                    _mm_add_ps(_mm_mul_ps(planeAbsX[p], hx), _mm_mul_ps(planeAbsY[p], hy)),
+                                    _mm_mul_ps(planeAbsZ[p], hz));
+                inside = _mm_and_ps(inside,
+                                    _mm_cmpge_ps(_mm_add_ps(distance, radius), epsilon));
+            }
+        }
+
+        int mask = _mm_movemask_ps(inside);
+
+        if(mask == 0) continue;
+
+        // squared distance from box center to the eye
+        __m128 dx = _mm_sub_ps(wx, eyeX);
+        __m128 dy = _mm_sub_ps(wy, eyeY);
+        __m128 dz = _mm_sub_ps(wz, eyeZ);
+        __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy,
+                                      dy)), _mm_mul_ps(dz, dz));
+        float laneDistance[SIMDWidth];
+        _mm_storeu_ps(laneDistance, distance2);
+
+        // compact the surviving lanes into the visible list
+        for(unsigned int lane = 0; lane < SIMDWidth; lane++)
+        {
+            if((mask & (1 << lane)) && i + lane < boxCount)
+            {
+                visible.push_back(i + lane);
+                distances.push_back(laneDistance[lane]);
+            }
+        }
+    }
+}
+
+void FrustumCuller::sortFrontToBack()
+{
+    std::vector<std::pair<float, unsigned int>> order(visible.size());
+
+    for(unsigned int i = 0; i < visible.size(); i++)
+    {
+        order[i] = std::make_pair(distances[i], visible[i]);
+    }
+
+    std::sort(order.begin(), order.end());
+
+    for(unsigned int i = 0; i < order.size(); i++)
+    {
+        distances[i] = order[i].first;
+        visible[i] = order[i].second;
+    }
+}
+
+FrustumCuller::FrustumCuller() : boxCount(0)
+{
+}
+
+FrustumCuller::~FrustumCuller()
+{
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+class FrustumCuller
+{
+    public:
+        // boxes processed per simd iteration
+        static const unsigned int SIMDWidth = 4;
+    private:
+        // model space bounding boxes stored as a structure of arrays,
+        // padded to a multiple of the simd width
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> extentX;
+        std::vector<float> extentY;
+        std::vector<float> extentZ;
+        unsigned int boxCount;
+        // compact list of the boxes that passed the last cull
+        std::vector<unsigned int> visible;
+        // squared distance to the eye per visible box
+        std::vector<float> distances;
+        // corner of a unit box farthest along v, as an index in cornerOffsets
+        static int vectorToIndex(const glm::vec3 &v);
+        // 1 in front of the plane, 0 behind, 2 on it
+        static int halfPlaneTest(const glm::vec3 &p, const glm::vec3 &normal,
+                                 float offset);
+    public:
+        // the six normalized frustum planes of a view projection matrix,
+        // right, left, bottom, top, far and near, normal(xyz) offset(w)
+        static void extractPlanes(const glm::mat4 &matrix, glm::vec4 planes[6]);
+        // a single box against the planes one at a time, 0 outside, 1
+        // inside and 3 intersecting. cull tests many boxes faster
+        static int testBox(const glm::vec4 * planes, const glm::vec3 &origin,
+                           const glm::vec3 &halfDim);
+        // reserves space for count boxes, previous boxes are discarded
+        void resize(unsigned int count);
+        // sets the box at index, dimension is the full box size
+        void setBox(unsigned int index, const glm::vec3 &center,
+                    const glm::vec3 &dimension);
+        // tests every box against the six frustum planes in one pass, boxes
+        // are transformed by model first. if testPlanes is false every box
+        // is returned as visible, distances are still calculated
+        void cull(const glm::vec4 * planes, const glm::mat4 &model,
+                  const glm::vec3 &eye, bool testPlanes);
+        // orders the visible list by ascending distance to the eye
+        void sortFrontToBack();
+        // drops the visible boxes for which predicate(index) returns true,
+        // boxes are visited in list order and the order is kept
+        template<typename Predicate>
+        void removeVisible(Predicate predicate)
+        {
+            unsigned int kept = 0;
+
+            for(unsigned int i = 0; i < visible.size(); i++)
+            {
+                if(predicate(visible[i])) continue;
+
+                visible[kept] = visible[i];
+                distances[kept++] = distances[i];
+            }
+
+            visible.resize(kept);
+            distances.resize(kept);
+        }
+        // boxes that passed the last cull call
+        const std::vector<unsigned int> &Visible() const { return visible; }
+        const std::vector<float> &Distances() const { return distances; }
+        unsigned int BoxCount() const { return boxCount; }
+
+        FrustumCuller();
+        ~FrustumCuller();
+};
+
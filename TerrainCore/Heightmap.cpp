@@ -1,5 +1,6 @@
 #include "Commons.h"
 #include "Heightmap.h"
+#include "Parallel.h"
 
 int counter = 0;
 
@@ -31,7 +32,52 @@ void Heightmap::setSize(const int x, const int y)
 
 void Heightmap::build()
 {
-    heightmapBuilder.Build();
+    // same checks and values as NoiseMapBuilderPlane::Build, its row
+    // loop is serial so the rows are spread over the job system here
+    if(topLeft <= bottomLeft || topRigth <= bottomRight
+       || width <= 0 || heigth <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    heightmap.SetSize(width, heigth);
+    model::Plane plane(terrainSelector);
+    const double xDelta = ((double)topLeft - bottomLeft) / width;
+    const double zDelta = ((double)topRigth - bottomRight) / heigth;
+    // accumulated as the builder does so every value matches it
+    std::vector<double> rowZ(heigth);
+    double zCur = bottomRight;
+
+    for(int z = 0; z < heigth; z++)
+    {
+        rowZ[z] = zCur;
+        zCur += zDelta;
+    }
+
+    Parallel::forEach(0, heigth, [&](int z)
+    {
+        float * dest = heightmap.GetSlabPtr(z);
+        double xCur = bottomLeft;
+
+        for(int x = 0; x < width; x++)
+        {
+            dest[x] = (float)plane.GetValue(xCur, rowZ[z]);
+            xCur += xDelta;
+        }
+    });
+}
+
+void Heightmap::load(const float * values, const int width,
+                     const int height)
+{
+    setSize(width, height);
+    heightmap.SetSize(width, height);
+
+    for(int y = 0; y < height; y++)
+    {
+        std::memcpy(heightmap.GetSlabPtr(y), values + y * width,
+                    width * sizeof(float));
+    }
 }
 
 void Heightmap::writeToFile(const std::string & filename)
@@ -43,7 +43,11 @@ class Heightmap
                        const float bottomRight, const float topRigth);
         void setSeed(int seed);
         void setSize(const int x, const int y);
+        // noise values of the whole plane, rows are built in parallel
         void build();
+        // replaces the built values with width * height stored values,
+        // rows one after the other
+        void load(const float * values, const int width, const int height);
         void writeToFile(const std::string & filename);
         float getValue(int x, int y);
 
@@ -0,0 +1,363 @@
+#include "Commons.h"
+#include "JobSystem.h"
+
+// thread local storage for plain values, thread_local isn't supported by vs2013
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// pool index of the worker on this thread, -1 outside the pool
+static THREAD_LOCAL int workerIndex = -1;
+// priority of the job running on this thread
+static THREAD_LOCAL int currentPriority = JobSystem::Interactive;
+
+class JobSystem::Job
+{
+    public:
+        std::function<void()> work;
+        Priority priority;
+        // unfinished dependencies, plus one until submitted
+        std::atomic<int> pending;
+        // claimed by the thread running it, a waiter may run it before a
+        // worker gets to its queue entry
+        std::atomic<bool> started;
+        std::atomic<bool> done;
+        // guards continuations against finish
+        std::mutex mutex;
+        std::vector<JobHandle> continuations;
+
+        Job(std::function<void()> work, Priority priority) :
+            work(std::move(work)), priority(priority), pending(1), started(false),
+            done(false)
+        {
+        }
+};
+
+JobSystem JobSystem::instance;
+
+JobSystem::JobHandle JobSystem::create(std::function<void()> work,
+                                       Priority priority)
+{
+    return std::make_shared<Job>(std::move(work), priority);
+}
+
+JobSystem::JobHandle JobSystem::create(std::function<void()> work)
+{
+    return create(std::move(work), CurrentPriority());
+}
+
+void JobSystem::addDependency(const JobHandle &job,
+                              const JobHandle &prerequisite)
+{
+    std::lock_guard<std::mutex> lock(prerequisite->mutex);
+
+    if(prerequisite->done) return;
+
+    job->pending++;
+    prerequisite->continuations.push_back(job);
+}
+
+void JobSystem::submit(const JobHandle &job)
+{
+    if(--job->pending == 0) Pool().push(job);
+}
+
+JobSystem::JobHandle JobSystem::run(std::function<void()> work,
+                                    Priority priority)
+{
+    JobHandle job = create(std::move(work), priority);
+    submit(job);
+    return job;
+}
+
+JobSystem::JobHandle JobSystem::run(std::function<void()> work)
+{
+    return run(std::move(work), CurrentPriority());
+}
+
+JobSystem::JobHandle JobSystem::then(const JobHandle &prerequisite,
+                                     std::function<void()> work)
+{
+    JobHandle job = create(std::move(work), prerequisite->priority);
+    addDependency(job, prerequisite);
+    submit(job);
+    return job;
+}
+
+void JobSystem::wait(const JobHandle &job)
+{
+    if(!job) return;
+
+    JobSystem &pool = Pool();
+
+    // still queued, the caller would block until a worker gets to it
+    if(job->pending == 0) pool.execute(job);
+
+    // other than job, the main thread never ends up running a whole bake
+    const int lowest = currentPriority;
+
+    while(!job->done)
+    {
+        JobHandle next = pool.pop(lowest);
+
+        if(next)
+        {
+            pool.execute(next);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(pool.wakeMutex);
+        pool.waiting++;
+        pool.wake.wait(lock, [&]()
+        {
+            return job->done || pool.hasQueued(lowest);
+        });
+        pool.waiting--;
+    }
+}
+
+bool JobSystem::finished(const JobHandle &job)
+{
+    return !job || job->done;
+}
+
+JobSystem::Priority JobSystem::CurrentPriority()
+{
+    return Priority(currentPriority);
+}
+
+unsigned int JobSystem::WorkerCount()
+{
+    return Pool().workers.size() - 1;
+}
+
+void JobSystem::workerStats(std::vector<WorkerStats> &stats)
+{
+    JobSystem &pool = Pool();
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - pool.statsReset).count();
+    stats.resize(pool.workers.size() - 1);
+
+    for(size_t i = 0; i < stats.size(); i++)
+    {
+        const Worker &worker = *pool.workers[i];
+        stats[i].jobs = worker.jobsRun;
+        stats[i].steals = worker.steals;
+        stats[i].busySeconds = worker.busyNanoseconds * 1e-9;
+        stats[i].utilization = elapsed > 0.0
+                               ? (float)std::min(1.0, stats[i].busySeconds / elapsed) : 0.0f;
+    }
+}
+
+void JobSystem::resetStats()
+{
+    JobSystem &pool = Pool();
+
+    for(auto &worker : pool.workers)
+    {
+        worker->jobsRun = 0;
+        worker->steals = 0;
+        worker->busyNanoseconds = 0;
+    }
+
+    pool.statsReset = std::chrono::steady_clock::now();
+}
+
+JobSystem &JobSystem::Pool()
+{
+    std::call_once(instance.started, [&]() { instance.start(); });
+    return instance;
+}
+
+void JobSystem::start()
+{
+    // the main thread keeps one core, at least one worker so
+    // background jobs still run next to it
+    int count = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+    for(int i = 0; i <= count; i++)
+    {
+        workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+
+    statsReset = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < count; i++)
+    {
+        workers[i]->thread = std::thread(&JobSystem::workerMain, this, i);
+    }
+}
+
+void JobSystem::workerMain(int index)
+{
+    workerIndex = index;
+
+    while(true)
+    {
+        JobHandle job = pop(PriorityCount - 1);
+
+        if(job)
+        {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        sleeping++;
+        wake.wait(lock, [this]()
+        {
+            return stopping || hasQueued(PriorityCount - 1);
+        });
+        sleeping--;
+
+        if(stopping) return;
+    }
+}
+
+void JobSystem::push(const JobHandle &job)
+{
+    Worker &worker = *workers[workerIndex >= 0 ? workerIndex : workers.size() - 1];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs[job->priority].push_back(job);
+        queued[job->priority]++;
+    }
+
+    if(sleeping > 0 || waiting > 0) wakeAll();
+}
+
+JobSystem::JobHandle JobSystem::pop(int lowest)
+{
+    const int count = workers.size();
+    const int own = workerIndex >= 0 ? workerIndex : count - 1;
+
+    for(int priority = 0; priority <= lowest; priority++)
+    {
+        if(queued[priority] <= 0) continue;
+
+        // newest own job first, its data is likely still in cache
+        {
+            Worker &worker = *workers[own];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            std::deque<JobHandle> &jobs = worker.jobs[priority];
+
+            if(!jobs.empty())
+            {
+                JobHandle job = std::move(jobs.back());
+                jobs.pop_back();
+                queued[priority]--;
+                return job;
+            }
+        }
+
+        // then the oldest job of everyone else
+        for(int i = 1; i < count; i++)
+        {
+            int victim = (own + i) % count;
+            Worker &worker = *workers[victim];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            std::deque<JobHandle> &jobs = worker.jobs[priority];
+
+            if(jobs.empty()) continue;
+
+            JobHandle job = std::move(jobs.front());
+            jobs.pop_front();
+            queued[priority]--;
+
+            // the shared queue of outside threads isn't stealing
+            if(workerIndex >= 0 && victim != count - 1) workers[workerIndex]->steals++;
+
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+bool JobSystem::hasQueued(int lowest) const
+{
+    for(int priority = 0; priority <= lowest; priority++)
+    {
+        if(queued[priority] > 0) return true;
+    }
+
+    return false;
+}
+
+void JobSystem::execute(const JobHandle &job)
+{
+    // a waiter already ran it, this is its stale queue entry
+    if(job->started.exchange(true)) return;
+
+    typedef std::chrono::steady_clock Clock;
+    int previousPriority = currentPriority;
+    currentPriority = job->priority;
+    Clock::time_point begin = Clock::now();
+    job->work();
+    // release whatever the work captured before anyone sees it done
+    job->work = nullptr;
+
+    if(workerIndex >= 0)
+    {
+        Worker &worker = *workers[workerIndex];
+        worker.busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>
+                                  (Clock::now() - begin).count();
+        worker.jobsRun++;
+    }
+
+    currentPriority = previousPriority;
+    finish(job);
+}
+
+void JobSystem::finish(const JobHandle &job)
+{
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        continuations.swap(job->continuations);
+    }
+
+    for(auto &continuation : continuations)
+    {
+        if(--continuation->pending == 0) push(continuation);
+    }
+
+    if(waiting > 0) wakeAll();
+}
+
+void JobSystem::wakeAll()
+{
+    // a thread between checking its condition and blocking holds the
+    // mutex, taking it here means it can't miss the notification
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wake.notify_all();
+}
+
+JobSystem::Worker::Worker() : jobsRun(0), steals(0), busyNanoseconds(0)
+{
+}
+
+JobSystem::JobSystem() : sleeping(0), waiting(0), stopping(false)
+{
+    for(auto &count : queued) count = 0;
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for(auto &worker : workers)
+    {
+        if(worker->thread.joinable()) worker->thread.join();
+    }
+}
+
@@ -0,0 +1,101 @@
+#pragma once
+
+// work stealing scheduler shared by every pipeline stage. each worker
+// keeps a deque per priority, runs its newest job first and steals the
+// oldest ones of the other workers once it runs out, interactive jobs
+// always go before background bakes. a thread waiting on a job runs
+// queued jobs meanwhile, so jobs can wait on the jobs they submit
+class JobSystem
+{
+    public:
+        enum Priority
+        {
+            // work the main thread is waiting for, generation and meshing
+            Interactive = 0,
+            // bakes that finish while the terrain is being rendered
+            Background,
+            PriorityCount
+        };
+        class Job;
+        typedef std::shared_ptr<Job> JobHandle;
+        // what one worker did since the last resetStats call
+        struct WorkerStats
+        {
+            unsigned int jobs;
+            // jobs taken from the queue of another thread
+            unsigned int steals;
+            double busySeconds;
+            // busy fraction of the time since the last reset
+            float utilization;
+        };
+        // the job runs once submitted and all its dependencies finished
+        static JobHandle create(std::function<void()> work, Priority priority);
+        // same priority as the job running on this thread, interactive
+        // on threads outside the pool
+        static JobHandle create(std::function<void()> work);
+        // job won't start before prerequisite has finished, call it
+        // before submitting job
+        static void addDependency(const JobHandle &job, const JobHandle &prerequisite);
+        static void submit(const JobHandle &job);
+        // creates and submits a job
+        static JobHandle run(std::function<void()> work, Priority priority);
+        static JobHandle run(std::function<void()> work);
+        // submits a continuation, runs once prerequisite has finished
+        static JobHandle then(const JobHandle &prerequisite, std::function<void()> work);
+        // returns once job has finished. runs job right away if it's still
+        // queued, else runs queued jobs at least as urgent as the one
+        // running on this thread meanwhile
+        static void wait(const JobHandle &job);
+        static bool finished(const JobHandle &job);
+        // priority of the job running on this thread
+        static Priority CurrentPriority();
+        static unsigned int WorkerCount();
+        // one entry per worker, call from a single thread
+        static void workerStats(std::vector<WorkerStats> &stats);
+        static void resetStats();
+    private:
+        struct Worker
+        {
+            // guards jobs, the owner pops from the back, thieves from the front
+            std::mutex mutex;
+            std::array<std::deque<JobHandle>, PriorityCount> jobs;
+            std::thread thread;
+            std::atomic<unsigned int> jobsRun;
+            std::atomic<unsigned int> steals;
+            std::atomic<long long> busyNanoseconds;
+
+            Worker();
+        };
+        static JobSystem instance;
+        std::once_flag started;
+        // one per pool thread plus a last one with no thread, threads
+        // outside the pool submit to it
+        std::vector<std::unique_ptr<Worker>> workers;
+        // jobs sitting in any queue, per priority
+        std::array<std::atomic<int>, PriorityCount> queued;
+        // sleeping workers and waiting threads block on wake
+        std::mutex wakeMutex;
+        std::condition_variable wake;
+        std::atomic<int> sleeping;
+        std::atomic<int> waiting;
+        bool stopping;
+        std::chrono::steady_clock::time_point statsReset;
+
+        static JobSystem &Pool();
+        void start();
+        void workerMain(int index);
+        // queues a job whose dependencies are done
+        void push(const JobHandle &job);
+        // most urgent queued job up to lowest priority, null if none
+        JobHandle pop(int lowest);
+        bool hasQueued(int lowest) const;
+        // runs job unless another thread already claimed it
+        void execute(const JobHandle &job);
+        // marks job done and queues the continuations it was holding
+        void finish(const JobHandle &job);
+        void wakeAll();
+
+        JobSystem();
+        ~JobSystem();
+};
+
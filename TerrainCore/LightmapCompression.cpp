@@ -0,0 +1,60 @@
+#include "Commons.h"
+#include "LightmapCompression.h"
+#include "Parallel.h"
+
+const unsigned char LightmapCompression::ShadowValue;
+const int LightmapCompression::BlockSize;
+const int LightmapCompression::BlockBytes;
+
+void LightmapCompression::encodeBC4(const std::vector<unsigned char> &lightmap,
+                                    int size, unsigned char * blocks)
+{
+    const int blocksPerRow = size / BlockSize;
+    Parallel::forEach(0, blocksPerRow, [&](int by)
+    {
+        for(int bx = 0; bx < blocksPerRow; bx++)
+        {
+            unsigned char * block = blocks + (by * blocksPerRow + bx) * BlockBytes;
+            unsigned char texels[BlockSize * BlockSize];
+            unsigned char high = 0, low = 255;
+
+            for(int y = 0; y < BlockSize; y++)
+            {
+                const unsigned char * row = &lightmap[(by * BlockSize + y) * size
+                                                      + bx * BlockSize];
+
+                for(int x = 0; x < BlockSize; x++)
+                {
+                    texels[y * BlockSize + x] = row[x];
+                    high = std::max(high, row[x]);
+                    low = std::min(low, row[x]);
+                }
+            }
+
+            // high > low selects the eight value mode, index 0 decodes to
+            // high, 1 to low and 2..7 to the six steps between them
+            std::uint64_t indices = 0;
+
+            if(high > low)
+            {
+                const float range = (float)(high - low);
+
+                for(int i = 0; i < BlockSize * BlockSize; i++)
+                {
+                    int step = (int)((high - texels[i]) * 7.0f / range + 0.5f);
+                    std::uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+                    indices |= index << (3 * i);
+                }
+            }
+
+            block[0] = high;
+            block[1] = low;
+
+            for(int i = 0; i < 6; i++)
+            {
+                block[2 + i] = (unsigned char)(indices >> (8 * i));
+            }
+        }
+    });
+}
+
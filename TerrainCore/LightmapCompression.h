@@ -0,0 +1,24 @@
+#pragma once
+
+// baked lightmaps are sent to the gpu and to the bake cache as bc4 blocks,
+// half a byte per texel
+class LightmapCompression
+{
+    public:
+        // texel value the bakers write for fully shadowed texels
+        static const unsigned char ShadowValue = 192;
+        // bc4 block side in texels and size in bytes
+        static const int BlockSize = 4;
+        static const int BlockBytes = 8;
+        // bytes for the bc4 blocks of a size * size lightmap, size is a
+        // multiple of BlockSize
+        static size_t blocksSize(int size)
+        {
+            return (size_t)(size / BlockSize) * (size / BlockSize) * BlockBytes;
+        }
+        // bc4 blocks in row order, endpoints are the block extremes so
+        // fully lit and fully shadowed blocks decode exactly
+        static void encodeBC4(const std::vector<unsigned char> &lightmap, int size,
+                              unsigned char * blocks);
+};
+
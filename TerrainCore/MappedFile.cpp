@@ -0,0 +1,133 @@
+#include "Commons.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string &filename)
+{
+    close();
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if(file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+
+    if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if(mapping == NULL)
+    {
+        close();
+        return false;
+    }
+
+    data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    size = (size_t)fileSize.QuadPart;
+
+    if(data == nullptr)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(data) UnmapViewOfFile(data);
+
+    if(mapping != NULL) CloseHandle(mapping);
+
+    if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+    data = nullptr;
+    size = 0;
+}
+
+MappedFile::MappedFile() : file(INVALID_HANDLE_VALUE), mapping(NULL),
+    data(nullptr), size(0)
+{
+}
+#else
+bool MappedFile::open(const std::string &filename)
+{
+    close();
+    file = ::open(filename.c_str(), O_RDONLY);
+
+    if(file < 0) return false;
+
+    struct stat fileStat;
+
+    if(fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    void * view = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    if(view == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+
+    data = (const unsigned char *)view;
+    size = (size_t)fileStat.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(data) munmap((void *)data, size);
+
+    if(file >= 0) ::close(file);
+
+    file = -1;
+    data = nullptr;
+    size = 0;
+}
+
+MappedFile::MappedFile() : file(-1), data(nullptr), size(0)
+{
+}
+#endif
+
+bool MappedFile::replace(const std::string &filename,
+                         const std::function<void(std::ostream &)> &writer)
+{
+    std::string temporal = filename + ".tmp";
+    bool written = false;
+    {
+        std::ofstream output(temporal, std::ios::binary | std::ios::trunc);
+
+        if(!output) return false;
+
+        writer(output);
+        output.close();
+        written = !output.fail();
+    }
+
+    if(written)
+    {
+        std::remove(filename.c_str());
+
+        if(std::rename(temporal.c_str(), filename.c_str()) == 0) return true;
+    }
+
+    std::remove(temporal.c_str());
+    return false;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+class MappedFile
+{
+    private:
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#else
+        int file;
+#endif
+        // read only view of the whole file
+        const unsigned char * data;
+        size_t size;
+    public:
+        // maps filename for reading, closes the previous mapping
+        bool open(const std::string &filename);
+        void close();
+
+        // writes filename through writer aside and renames it over the old
+        // file, so a reader never maps a partially written one. nothing
+        // is left behind if the stream fails or the rename does
+        static bool replace(const std::string &filename,
+                            const std::function<void(std::ostream &)> &writer);
+
+        const unsigned char * Data() const { return data; }
+        size_t Size() const { return size; }
+        bool IsOpen() const { return data != nullptr; }
+
+        MappedFile();
+        ~MappedFile();
+};
+
@@ -0,0 +1,67 @@
+#include "Commons.h"
+#include "Parallel.h"
+
+const int Parallel::RangesPerThread;
+
+void Parallel::run(int first, int last, int grain,
+                   const std::function<void(int, int)> &body)
+{
+    if(last <= first) return;
+
+    const int count = last - first;
+    const int workers = JobSystem::WorkerCount();
+
+    if(grain <= 0)
+    {
+        int tasks = (workers + 1) * RangesPerThread;
+        grain = std::max(1, (count + tasks - 1) / tasks);
+    }
+
+    const int ranges = (count + grain - 1) / grain;
+
+    // not worth a job
+    if(ranges <= 1)
+    {
+        body(first, last);
+        return;
+    }
+
+    Loop loop;
+    loop.body = &body;
+    loop.next = first;
+    loop.last = last;
+    loop.grain = grain;
+    // helpers starting late find no ranges left and return right away
+    std::vector<JobSystem::JobHandle> helpers(std::min(ranges - 1, workers));
+
+    for(auto &helper : helpers)
+    {
+        helper = JobSystem::run([&loop]() { work(loop); });
+    }
+
+    work(loop);
+
+    // the loop lives on this stack
+    for(auto &helper : helpers)
+    {
+        JobSystem::wait(helper);
+    }
+}
+
+void Parallel::work(Loop &loop)
+{
+    while(true)
+    {
+        int begin = loop.next.fetch_add(loop.grain);
+
+        if(begin >= loop.last) return;
+
+        (*loop.body)(begin, std::min(begin + loop.grain, loop.last));
+    }
+}
+
+unsigned int Parallel::ThreadCount()
+{
+    return JobSystem::WorkerCount() + 1;
+}
+
@@ -0,0 +1,52 @@
+#pragma once
+#include "JobSystem.h"
+
+// data parallel loops on the job system. the calling thread works on its
+// own loop too, helper jobs take the priority of the job running the
+// loop, so loops of a background bake never delay interactive ones
+class Parallel
+{
+    private:
+        // one running loop, its ranges are handed out grain indices at a time
+        struct Loop
+        {
+            const std::function<void(int, int)> * body;
+            std::atomic<int> next;
+            int last;
+            int grain;
+        };
+        // ranges per thread when no grain is given, a few so uneven
+        // rows still balance
+        static const int RangesPerThread = 4;
+
+        static void run(int first, int last, int grain,
+                        const std::function<void(int, int)> &body);
+        // runs ranges of loop until there are none left
+        static void work(Loop &loop);
+    public:
+        // calls body(i) for every i in [first, last), each task runs grain
+        // consecutive indices, 0 splits the range in a few tasks per thread
+        template<typename Body>
+        static void forEach(int first, int last, const Body &body, int grain = 0)
+        {
+            std::function<void(int, int)> rangeBody = [&body](int begin, int end)
+            {
+                for(int i = begin; i < end; i++) body(i);
+            };
+            run(first, last, grain, rangeBody);
+        }
+        // calls body(begin, end) for consecutive ranges covering [first, last),
+        // for bodies that set up per range state once
+        template<typename Body>
+        static void forRanges(int first, int last, const Body &body, int grain = 0)
+        {
+            std::function<void(int, int)> rangeBody = [&body](int begin, int end)
+            {
+                body(begin, end);
+            };
+            run(first, last, grain, rangeBody);
+        }
+        // threads a loop runs on, the workers plus the caller
+        static unsigned int ThreadCount();
+};
+
@@ -0,0 +1,391 @@
+#include "Commons.h"
+#include "ShadowmapBaker.h"
+#include "LightmapCompression.h"
+#include "Parallel.h"
+
+const float ShadowmapBaker::SunTime = 0.6f;
+const float ShadowmapBaker::MoonAltitude = 1.3f;
+const float ShadowmapBaker::SunAltitude = 1.9f;
+
+glm::vec3 ShadowmapBaker::lightDirection(float time, float sunTime,
+        float sunAltitude, float moonAltitude)
+{
+    float dirX = std::sin(time) + 0.3f;
+    float dirZ = 0.7f;
+    // scale to 0 -> 1
+    float dirY = (std::cos(time) + sunTime) / (1.0f + sunTime);
+
+    // scale to 0 -> -1
+    if(dirY < 0.0f)
+    {
+        float minimum = (1.0f - sunTime) / (1.0f + sunTime);
+        dirY = dirY / minimum;
+        // moon comes from other side, slowly
+        dirX += std::cos(time) * 0.25;
+    }
+
+    // scale moon and sun altitudes
+    if(dirY > 0.0) dirY *= sunAltitude;
+    else dirY *= moonAltitude;
+
+    return glm::vec3(dirX, std::abs(dirY), dirZ);
+}
+
+float ShadowmapBaker::sliceTime(int slice, int sliceCount)
+{
+    // the last slice ends the day, the first one is right after midnight
+    return glm::two_pi<float>() * (float)(slice + 1) / sliceCount;
+}
+
+void ShadowmapBaker::generateShadowmap(Method method, glm::vec3 lightDir,
+                                       std::vector<unsigned char> &lightmap, unsigned int lightmapSize,
+                                       const std::vector<float> &heights, unsigned int rowStride,
+                                       const BakingJob * job)
+{
+    if(method == Sweep)
+    {
+        sweepGenerateShadowmapParallel(lightDir, lightmap, lightmapSize, heights,
+                                       rowStride, job);
+    }
+    else
+    {
+        fastGenerateShadowmapParallel(lightDir, lightmap, lightmapSize, heights,
+                                      rowStride, job);
+    }
+}
+
+void ShadowmapBaker::sweepGenerateShadowmapParallel(glm::vec3 lightDir,
+        std::vector<unsigned char> &lightmap, unsigned int lightmapSize,
+        const std::vector<float> &heights, unsigned int rowStride,
+        const BakingJob * job)
+{
+    if(glm::length2(lightDir) == 0.0) return;
+
+    lightmap.assign(lightmapSize * lightmapSize, 0);
+    // scanlines run along the axis the light travels faster on
+    bool majorX = std::abs(lightDir[0]) > std::abs(lightDir[2]);
+    float majorDir = majorX ? lightDir[0] : lightDir[2];
+    float minorDir = majorX ? lightDir[2] : lightDir[0];
+
+    // light straight above, nothing casts shadows
+    if(majorDir == 0.0f) return;
+
+    // the march travels against lightDir, the previous scanline sample
+    // sits one line back on the major axis and this offset on the minor
+    float minorOffset = -minorDir / std::abs(majorDir);
+    // same rise along the ray as fastGenerateShadowmapParallel
+    float distanceStep = std::sqrt(lightDir[0] * lightDir[0] + lightDir[1] *
+                                   lightDir[1]);
+    float horizontalStep = std::sqrt(lightDir[0] * lightDir[0] + lightDir[2] *
+                                     lightDir[2]);
+    float risePerLine = lightDir[1] * distanceStep / horizontalStep
+                        * std::sqrt(1.0f + minorOffset * minorOffset);
+    // scanlines have to be contiguous, transpose when they are columns
+    std::vector<float> transposed;
+    const float * lineData = heights.data();
+    unsigned int lineStride = rowStride;
+
+    if(majorX)
+    {
+        transposed.resize(lightmapSize * lightmapSize);
+        Parallel::forEach(0, (int)lightmapSize, [&](int x)
+        {
+            for(unsigned int y = 0; y < lightmapSize; y++)
+            {
+                transposed[x * lightmapSize + y] = heights[y * rowStride + x];
+            }
+        });
+        lineData = transposed.data();
+        lineStride = lightmapSize;
+    }
+
+    // running shadow height, the top of the terrain or the shadow
+    // volume above it, for the previous and current scanline
+    std::vector<float> previous(lightmapSize, -std::numeric_limits<float>::max());
+    std::vector<float> current(lightmapSize);
+    // horizontal distance to the crest casting that shadow height
+    std::vector<float> previousDistance(lightmapSize, 0.0f);
+    std::vector<float> currentDistance(lightmapSize);
+    const float lineStep = std::sqrt(1.0f + minorOffset * minorOffset);
+    const float lastTexel = (float)(lightmapSize - 1);
+
+    for(unsigned int i = 0; i < lightmapSize; i++)
+    {
+        if(job && job->CancelRequested()) return;
+
+        // start from the scanline nearest to the light
+        unsigned int line = majorDir > 0.0f ? i : lightmapSize - i - 1;
+        const float * lineHeights = lineData + line * lineStride;
+        Parallel::forEach(0, (int)lightmapSize, [&](int n)
+        {
+            float shadowHeight = -std::numeric_limits<float>::max();
+            float occluderDistance = 0.0f;
+            float previousN = n + minorOffset;
+
+            if(previousN >= 0.0f && previousN <= lastTexel)
+            {
+                int n0 = int(previousN);
+                int n1 = std::min(n0 + 1, (int)lightmapSize - 1);
+                shadowHeight = glm::mix(previous[n0], previous[n1], previousN - n0)
+                               - risePerLine;
+                occluderDistance = glm::mix(previousDistance[n0], previousDistance[n1],
+                                            previousN - n0) + lineStep;
+            }
+
+            float height = lineHeights[n];
+
+            if(shadowHeight > height)
+            {
+                unsigned int index = majorX ? n * lightmapSize + line
+                                     : line * lightmapSize + n;
+                lightmap[index] = penumbraShadow(shadowHeight - height, occluderDistance);
+                current[n] = shadowHeight;
+                currentDistance[n] = occluderDistance;
+            }
+            else
+            {
+                // this texel is the crest now
+                current[n] = height;
+                currentDistance[n] = 0.0f;
+            }
+        });
+        previous.swap(current);
+        previousDistance.swap(currentDistance);
+    }
+}
+
+unsigned char ShadowmapBaker::penumbraShadow(float depth, float occluderDistance)
+{
+    // height units the penumbra grows per texel away from the occluder,
+    // a wide sun disk so distant ridges cast visibly soft shadows
+    const float penumbraSpread = 0.1f;
+    float shadow = std::min(1.0f, depth / (1.0f + occluderDistance * penumbraSpread));
+    return (unsigned char)(shadow * LightmapCompression::ShadowValue + 0.5f);
+}
+
+unsigned int ShadowmapBaker::resampleShadowHeights(const float * values,
+        int resolution, unsigned int lightmapSize, std::vector<float> &heights)
+{
+    // 16 floats per cache line, plus one padding column
+    unsigned int rowStride = (lightmapSize + 1 + 15) / 16 * 16;
+    heights.assign(rowStride * (lightmapSize + 1), 0.0f);
+    float sFactor = (float)resolution / lightmapSize;
+    Parallel::forEach(0, (int)lightmapSize, [&](int y)
+    {
+        float * row = &heights[y * rowStride];
+        const float * source = &values[int(y * sFactor) * resolution];
+
+        for(unsigned int x = 0; x < lightmapSize; x++)
+        {
+            row[x] = source[int(x * sFactor)] * 255.0f;
+        }
+
+        // padding repeats the border
+        row[lightmapSize] = row[lightmapSize - 1];
+    });
+    std::copy(
+        heights.begin() + (lightmapSize - 1) * rowStride,
+        heights.begin() + lightmapSize * rowStride,
+        heights.begin() + lightmapSize * rowStride
+    );
+    return rowStride;
+}
+
+void ShadowmapBaker::fastGenerateShadowmapParallel(glm::vec3 lightDir,
+        std::vector<unsigned char> &lightmap, unsigned int lightmapSize,
+        const std::vector<float> &heights, unsigned int rowStride,
+        const BakingJob * job)
+{
+    if(glm::length2(lightDir) == 0.0) return;
+
+    // initialize shadow map
+    lightmap = std::vector<unsigned char>(lightmapSize * lightmapSize);
+    // create flag buffer to indicate where we've been
+    std::vector<float> flagMap(lightmapSize * lightmapSize);
+    // horizontal distance from shadowed texels to their occluder
+    std::vector<float> occluderMap(lightmapSize * lightmapSize, 0.0f);
+    // calculate absolute values for light direction
+    float lightDirXMagnitude = lightDir[0];
+    float lightDirZMagnitude = lightDir[2];
+
+    if(lightDirXMagnitude < 0) lightDirXMagnitude *= -1;
+
+    if(lightDirZMagnitude < 0) lightDirZMagnitude *= -1;
+
+    float distanceStep = std::sqrt(lightDir[0] * lightDir[0] + lightDir[1] *
+                                   lightDir[1]);
+    float horizontalStep = std::sqrt(lightDir[0] * lightDir[0] + lightDir[2] *
+                                     lightDir[2]);
+    // decide which loop will come first, the y loop or x loop
+    // based on direction of light, makes calculations faster
+    const float * heightData = heights.data();
+    // outer loop
+    Parallel::forEach(0, (int)lightmapSize, [&](int y)
+    {
+        // remaining rows are skipped once the job is cancelled
+        if(job && job->CancelRequested()) return;
+
+        int *X, *Y;
+        int iX, iY;
+        int dirX, dirY;
+
+        // this might seem like a waste, why calculate it here? you can calculate it before...
+        // that's because threading is really picky about sharing variables. the less you share,
+        // the faster it goes.
+        if(lightDirXMagnitude > lightDirZMagnitude)
+        {
+            Y = &iX;
+            X = &iY;
+
+            if(lightDir[0] < 0)
+                dirY = -1;
+            else
+                dirY = 1;
+
+            if(lightDir[2] < 0)
+                dirX = -1;
+            else
+                dirX = 1;
+        }
+        else
+        {
+            Y = &iY;
+            X = &iX;
+
+            if(lightDir[0] < 0)
+                dirX = -1;
+            else
+                dirX = 1;
+
+            if(lightDir[2] < 0)
+                dirY = -1;
+            else
+                dirY = 1;
+        }
+
+        // if you decide to just do it single-threaded,
+        // just copy the previous block back just above the for loop
+
+        if(dirY < 0)
+            iY = lightmapSize - y - 1;
+        else
+            iY = y;
+
+        // inner loop
+        for(unsigned int x = 0; x < lightmapSize; x++)
+        {
+            if(dirX < 0)
+                iX = lightmapSize - x - 1;
+            else
+                iX = x;
+
+            float px, py, height, distance, origX, origY;
+            int index;
+            // travel along the terrain until we:
+            // (1) intersect another point
+            // (2) find another point with previous collision data
+            // (3) or reach the edge of the map
+            px = (float) * X;
+            py = (float) * Y;
+            origX = px;
+            origY = py;
+            index = (*Y) * lightmapSize + (*X);
+            distance = 0.0f;
+            float travelled = 0.0f;
+            // height of the starting point, constant along the ray
+            float originHeight = heightData[(*Y) * rowStride + (*X)];
+
+            // travel along ray
+            while(1)
+            {
+                px -= lightDir[0];
+                py -= lightDir[2];
+
+                // check if we've reached the boundary
+                if(px < 0 || px >= lightmapSize - 1 || py < 0 ||
+                   py >= lightmapSize - 1)
+                {
+                    flagMap[index] = -1;
+                    break;
+                }
+
+                // calculate interpolated values
+                int x0, x1, y0, y1;
+                float du, dv;
+                float interpolatedHeight, interpolatedFlagMap;
+                float invdu, invdv;
+                float w0, w1, w2, w3;
+                x0 = int(px);
+                y0 = int(py);
+                x1 = x0 + 1;
+                y1 = y0 + 1;
+                du = px - x0;
+                dv = py - y0;
+                invdu = 1.0f - du;
+                invdv = 1.0f - dv;
+                w0 = invdu * invdv;
+                w1 = invdu * dv;
+                w2 = du * invdv;
+                w3 = du * dv;
+                // compute interpolated height value from the heightmap direction below ray
+                const float * row0 = heightData + y0 * rowStride;
+                const float * row1 = row0 + rowStride;
+                interpolatedHeight = w0 * row0[x0] + w1 * row1[x0]
+                                     + w2 * row0[x1] + w3 * row1[x1];
+                // compute interpolated flagmap value from point directly below ray
+                interpolatedFlagMap = w0 * flagMap[y0 * lightmapSize + x0]
+                                      + w1 * flagMap[y1 * lightmapSize + x0]
+                                      + w2 * flagMap[y0 * lightmapSize + x1]
+                                      + w3 * flagMap[y1 * lightmapSize + x1];
+                // get distance from original point to current point
+                //distance = sqrtf( (px-origX)*(px-origX) + (py-origY)*(py-origY) );
+                distance += distanceStep;
+                travelled += horizontalStep;
+                // get height at current point while traveling along light ray
+                height = originHeight + lightDir[1] * distance;
+                // check intersection with either terrain or flagMap
+                // if interpolatedHeight is less than interpolatedFlagMap that means
+                // we need to use the flagMap value instead
+                // else use the height value
+                float val;
+
+                if(interpolatedHeight < interpolatedFlagMap) val = interpolatedFlagMap;
+                else val = interpolatedHeight;
+
+                if(height < val)
+                {
+                    // shadowed through a flagged texel, its occluder is farther
+                    float occluderDistance = travelled;
+
+                    if(interpolatedHeight < interpolatedFlagMap)
+                    {
+                        occluderDistance += w0 * occluderMap[y0 * lightmapSize + x0]
+                                            + w1 * occluderMap[y1 * lightmapSize + x0]
+                                            + w2 * occluderMap[y0 * lightmapSize + x1]
+                                            + w3 * occluderMap[y1 * lightmapSize + x1];
+                    }
+
+                    flagMap[index] = val - height;
+                    occluderMap[index] = occluderDistance;
+                    lightmap[index] = penumbraShadow(val - height, occluderDistance);
+                    break;
+                }
+
+                // check if pixel we've moved to is unshadowed
+                // since the flagMap value we're using is interpolated, we will be in
+                // between shadowed and unshadowed areas
+                // to compensate for this, simply define some epsilon value and use
+                // this as an offset from -1 to decide
+                // if current point under the ray is unshadowed
+                static float epsilon = 0.5f;
+
+                if(interpolatedFlagMap < -1.0f + epsilon &&
+                   interpolatedFlagMap > -1.0f - epsilon)
+                {
+                    flagMap[index] = -1.0f;
+                    break;
+                }
+            }
+        }
+    });
+}
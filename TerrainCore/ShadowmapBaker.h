@@ -0,0 +1,68 @@
+#pragma once
+#include "BakingJob.h"
+
+// sun shadows marched over the heightmap values, no gl calls so the
+// time of the day lightmaps can be baked on a job or without a window
+class ShadowmapBaker
+{
+    public:
+        enum Method
+        {
+            // one ray per texel marched towards the light
+            RayMarch = 0,
+            // light aligned scanlines carrying a running shadow height
+            Sweep
+        };
+        // default light path, the amount of time on daylight and the
+        // moon and sun heights
+        static const float SunTime;
+        static const float MoonAltitude;
+        static const float SunAltitude;
+        // light direction at time, a whole day is 2 pi
+        static glm::vec3 lightDirection(float time, float sunTime = SunTime,
+                                        float sunAltitude = SunAltitude,
+                                        float moonAltitude = MoonAltitude);
+        // day time the given time of the day lightmap is baked at
+        static float sliceTime(int slice, int sliceCount);
+        // heightmap resampled once at lightmap resolution in [0, 255], rows are
+        // padded to a cache line and one extra row and column are
+        // kept so the shadow march never needs bounds checks. values are
+        // resolution * resolution heights in [0, 1], returns the row stride
+        static unsigned int resampleShadowHeights(const float * values, int resolution,
+                unsigned int lightmapSize, std::vector<float> &heights);
+        // bakes with the given method over a resampled heightmap, job is
+        // polled for cancellation and may be null
+        static void generateShadowmap(
+            Method method,
+            glm::vec3 lightDir,
+            std::vector<unsigned char> &lightmap,
+            unsigned int lightmapSize,
+            const std::vector<float> &heights,
+            unsigned int rowStride,
+            const BakingJob * job
+        );
+        // visits every texel once, scanlines run along the light major axis
+        // and are processed in order, texels within one run in parallel
+        static void sweepGenerateShadowmapParallel(
+            glm::vec3 lightDir,
+            std::vector<unsigned char> &lightmap,
+            unsigned int lightmapSize,
+            const std::vector<float> &heights,
+            unsigned int rowStride,
+            const BakingJob * job
+        );
+        // shadow march over an already resampled heightmap
+        static void fastGenerateShadowmapParallel(
+            glm::vec3 lightDir,
+            std::vector<unsigned char> &lightmap,
+            unsigned int lightmapSize,
+            const std::vector<float> &heights,
+            unsigned int rowStride,
+            const BakingJob * job
+        );
+    private:
+        // baked texel value for a receiver depth units below the shadow
+        // boundary, the penumbra widens with the distance to the occluder
+        static unsigned char penumbraShadow(float depth, float occluderDistance);
+};
+
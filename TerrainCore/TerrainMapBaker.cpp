@@ -0,0 +1,155 @@
+#include "Commons.h"
+#include "TerrainMapBaker.h"
+#include "Parallel.h"
+
+const int TerrainMapBaker::OcclusionDirections;
+const int TerrainMapBaker::OcclusionRadius;
+
+bool TerrainMapBaker::bakeAmbientOcclusion(const float * heights,
+        int resolution, float heightScale, float horizontalScale,
+        std::vector<unsigned char> &occlusion, BakingJob * job)
+{
+    const int border = OcclusionRadius;
+    // rows padded to the simd width plus a border repeating the edge
+    // heights, every sample is a plain unaligned load of 4 texels
+    const int paddedWidth = (resolution + 3) / 4 * 4 + 2 * border;
+    const int paddedHeight = resolution + 2 * border;
+    std::vector<float> padded(paddedWidth * paddedHeight);
+    Parallel::forEach(0, paddedHeight, [&](int y)
+    {
+        int sourceY = std::min(std::max(y - border, 0), resolution - 1);
+        const float * source = heights + sourceY * resolution;
+
+        for(int x = 0; x < paddedWidth; x++)
+        {
+            int sourceX = std::min(std::max(x - border, 0), resolution - 1);
+            padded[y * paddedWidth + x] = source[sourceX] * heightScale;
+        }
+    });
+    // sample distances grow with the radius, far texels weigh less
+    const int distances[] = { 1, 2, 3, 4, 6, 8, 11, 16, 22, 32 };
+    const int stepCount = sizeof(distances) / sizeof(distances[0]);
+    const float texelSize = horizontalScale / std::max(resolution - 1, 1);
+    // sample offsets into the padded rows, snapped to whole texels
+    std::vector<int> offsets(OcclusionDirections * stepCount);
+    std::vector<float> inverseDistance(OcclusionDirections * stepCount);
+
+    for(int k = 0; k < OcclusionDirections; k++)
+    {
+        float angle = 2.0f * glm::pi<float>() * k / OcclusionDirections;
+
+        for(int j = 0; j < stepCount; j++)
+        {
+            int dx = (int)std::floor(std::cos(angle) * distances[j] + 0.5f);
+            int dy = (int)std::floor(std::sin(angle) * distances[j] + 0.5f);
+            offsets[k * stepCount + j] = dy * paddedWidth + dx;
+            inverseDistance[k * stepCount + j] =
+                1.0f / (std::sqrt((float)(dx * dx + dy * dy)) * texelSize);
+        }
+    }
+
+    occlusion.assign(resolution * resolution, 255);
+    Parallel::forEach(0, resolution, [&](int y)
+    {
+        if(job && job->CancelRequested()) return;
+
+        const float * row = &padded[(y + border) * paddedWidth + border];
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 directionWeight = _mm_set1_ps(1.0f / OcclusionDirections);
+
+        for(int x = 0; x < resolution; x += 4)
+        {
+            __m128 center = _mm_loadu_ps(row + x);
+            __m128 occluded = _mm_setzero_ps();
+
+            for(int k = 0; k < OcclusionDirections; k++)
+            {
+                const int * offset = &offsets[k * stepCount];
+                const float * inverse = &inverseDistance[k * stepCount];
+                __m128 maxSlope = _mm_setzero_ps();
+
+                for(int j = 0; j < stepCount; j++)
+                {
+                    __m128 height = _mm_loadu_ps(row + x + offset[j]);
+                    __m128 slope = _mm_mul_ps(_mm_sub_ps(height, center),
+                                              _mm_set1_ps(inverse[j]));
+                    maxSlope = _mm_max_ps(maxSlope, slope);
+                }
+
+                // sine of the horizon elevation angle
+                __m128 slope2 = _mm_add_ps(one, _mm_mul_ps(maxSlope, maxSlope));
+                occluded = _mm_add_ps(occluded,
+                                      _mm_mul_ps(maxSlope, _mm_rsqrt_ps(slope2)));
+            }
+
+            float openness[4];
+            _mm_storeu_ps(openness, _mm_sub_ps(one, _mm_mul_ps(occluded,
+                                               directionWeight)));
+
+            for(int lane = 0; lane < 4 && x + lane < resolution; lane++)
+            {
+                float value = std::min(std::max(openness[lane], 0.0f), 1.0f);
+                occlusion[y * resolution + x + lane] =
+                    (unsigned char)(value * 255.0f + 0.5f);
+            }
+        }
+
+        if(job) job->advance();
+    });
+    return !(job && job->CancelRequested());
+}
+
+void TerrainMapBaker::bakeNormalMap(const float * heights, int resolution,
+                                    std::vector<short> &normals)
+{
+    // mesh x and z span [-0.5, 0.5] over the whole heightmap
+    const float texelSize = 1.0f / std::max(resolution - 1, 1);
+    const int last = resolution - 1;
+    normals.resize(resolution * resolution * 2);
+    Parallel::forEach(0, resolution, [&](int y)
+    {
+        const float * row = heights + y * resolution;
+        const float * up = heights + std::max(y - 1, 0) * resolution;
+        const float * down = heights + std::min(y + 1, last) * resolution;
+        float spanZ = (std::min(y + 1, last) - std::max(y - 1, 0)) * texelSize;
+
+        for(int x = 0; x < resolution; x++)
+        {
+            int left = std::max(x - 1, 0);
+            int right = std::min(x + 1, last);
+            float slopeX = (row[right] - row[left]) / ((right - left) * texelSize);
+            float slopeZ = (down[x] - up[x]) / spanZ;
+            glm::vec3 normal = glm::normalize(glm::vec3(-slopeX, 1.0f, -slopeZ));
+            normals[(y * resolution + x) * 2] = (short)(normal.x * 32767.0f);
+            normals[(y * resolution + x) * 2 + 1] = (short)(normal.z * 32767.0f);
+        }
+    });
+}
+
+void TerrainMapBaker::bakeSplatMap(const float * heights, int resolution,
+                                   const float * ranges, int rangeCount,
+                                   std::vector<unsigned char> &weights)
+{
+    const int layerSize = resolution * resolution * 4;
+    weights.assign(layerSize * ((rangeCount + 3) / 4), 0);
+    Parallel::forEach(0, resolution, [&](int y)
+    {
+        for(int x = 0; x < resolution; x++)
+        {
+            float height = heights[y * resolution + x];
+
+            for(int i = 0; i < rangeCount; i++)
+            {
+                // ramps up over the range and fades out past its end
+                float regionMin = ranges[i * 3];
+                float regionMax = ranges[i * 3 + 1];
+                float regionRange = regionMax - regionMin;
+                float weight = regionRange > 0.0f ? std::max(0.0f,
+                               (regionRange - std::abs(height - regionMax)) / regionRange) : 0.0f;
+                weights[(i / 4) * layerSize + (y * resolution + x) * 4 + i % 4] =
+                    (unsigned char)(std::min(weight, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    });
+}
+
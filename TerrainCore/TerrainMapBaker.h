@@ -0,0 +1,32 @@
+#pragma once
+#include "BakingJob.h"
+
+// sun independent maps baked from the heightmap values, no gl calls
+// so they can run on a baking job
+class TerrainMapBaker
+{
+    public:
+        // directions marched per texel and farthest distance in texels
+        static const int OcclusionDirections = 8;
+        static const int OcclusionRadius = 32;
+        // horizon based ambient occlusion, 255 is fully open sky. heights
+        // are resolution * resolution values in [0, 1], scaled by
+        // heightScale and horizontalScale to the mesh proportions. returns
+        // false if job was cancelled before finishing, job may be null
+        static bool bakeAmbientOcclusion(const float * heights, int resolution,
+                                         float heightScale, float horizontalScale,
+                                         std::vector<unsigned char> &occlusion,
+                                         BakingJob * job);
+        // mesh space normals by central differences, heights are resolution
+        // * resolution mesh heights in [0, 1] over the unit square. x and z
+        // are stored as snorm16 pairs, y is positive and rebuilt from them
+        static void bakeNormalMap(const float * heights, int resolution,
+                                  std::vector<short> &normals);
+        // texture range weights per texel, ranges holds min, max and active
+        // for each of rangeCount ranges. four weights per rgba texel, one
+        // layer of resolution * resolution texels per four ranges
+        static void bakeSplatMap(const float * heights, int resolution,
+                                 const float * ranges, int rangeCount,
+                                 std::vector<unsigned char> &weights);
+};
+
@@ -0,0 +1,357 @@
+#include "Commons.h"
+#include "TerrainMeshBuilder.h"
+#include "Parallel.h"
+
+const int TerrainMeshBuilder::ChunkSizeExponent;
+
+float TerrainMeshBuilder::vertexHeight(Heightmap &heightmap, int x, int y)
+{
+    const int resolution = heightmap.Width();
+    float samplesSum = 0.0;
+    int samplesWeight = 0;
+
+    // get vertex height from heightmap data
+    for(int i = -1; i <= 1; i++)
+    {
+        for(int j = -1; j <= 1; j++)
+        {
+            if(i + x >= 0
+               && i + x <= resolution - 1
+               && j + y >= 0
+               && j + y <= resolution - 1)
+            {
+                samplesWeight++;
+                samplesSum += heightmap.getValue(i + x, j + y);
+            }
+        }
+    }
+
+    float height = samplesSum / samplesWeight;
+    // transform from [-1,1] to [0,1]
+    return std::min(std::max((height + 1.0f) / 2.0f, 0.0f), 1.0f);
+}
+
+void TerrainMeshBuilder::buildMesh(Heightmap &heightmap,
+                                   const int meshResExponent, std::vector<glm::vec3> &vertices,
+                                   std::vector<glm::vec3> &normals, std::vector<glm::vec2> &texCoords,
+                                   std::vector<unsigned int> &indices)
+{
+    const int meshResolution = (1 << meshResExponent) + 1;
+    const int terrainResolution = heightmap.Width();
+    // reserve space for new data
+    vertices.resize(meshResolution * meshResolution);
+    normals.resize(meshResolution * meshResolution);
+    texCoords.resize(meshResolution * meshResolution);
+    indices.resize((meshResolution - 1) * meshResolution * 2 + meshResolution);
+    // index buffer restart triangle strip
+    int restartIndex = meshResolution * meshResolution;
+    // parallel modification
+    Parallel::forEach(0, meshResolution, [&](int i)
+    {
+        int indexAt = i * (2 * meshResolution + 1);
+
+        for(int j = 0; j < meshResolution; j++)
+        {
+            // scales to x, z [0.0, 1.0]
+            float colScale = (float)j / (meshResolution - 1);
+            float rowScale = (float)i / (meshResolution - 1);
+            // height map positions
+            int xCor = (int)(j * (float)terrainResolution / meshResolution);
+            int yCor = (int)(i * (float)terrainResolution / meshResolution);
+            // create vertex position
+            vertices[i * meshResolution + j] =
+                glm::vec3(
+                    -0.5f + colScale,
+                    vertexHeight(heightmap, xCor, yCor),
+                    -0.5f + rowScale
+                );
+            // also create the appropiate texcoord
+            texCoords[i * meshResolution + j] =
+                glm::vec2(
+                    colScale,
+                    rowScale
+                );
+
+            // create triangle strip indices
+            if(i != meshResolution - 1)
+            {
+                indices[j * 2 + indexAt] = ((i + 1) * meshResolution + j);
+                indices[(j + 1) * 2 - 1 + indexAt] = (i * meshResolution + j);
+            }
+        }
+
+        // indices restart token
+        if(i != meshResolution - 1)
+        {
+            int restartAt = 2 * (i + 1) * meshResolution + i;
+            indices[restartAt] = restartIndex;
+        }
+    });
+    //// calculate face normals
+    std::array<std::vector<std::vector<glm::vec3>>, 2> faceNormals;
+    faceNormals[0] = faceNormals[1] = std::vector<std::vector<glm::vec3>>
+                                      (meshResolution - 1, std::vector<glm::vec3>(meshResolution - 1));
+    Parallel::forEach(0, meshResolution - 1, [&](int i)
+    {
+        for(int j = 0; j < meshResolution - 1; j++)
+        {
+            glm::vec3 triangle0[] =
+            {
+                vertices[i * meshResolution + j],
+                vertices[(i + 1) * meshResolution + j],
+                vertices[(i + 1) * meshResolution + j + 1]
+            };
+            glm::vec3 triangle1[] =
+            {
+                vertices[(i + 1) * meshResolution + j + 1],
+                vertices[i * meshResolution + j + 1],
+                vertices[i * meshResolution + j]
+            };
+            glm::vec3 t0Normal = glm::cross(triangle0[0] - triangle0[1],
+                                            triangle0[1] - triangle0[2]);
+            glm::vec3 t1Normal = glm::cross(triangle1[0] - triangle1[1],
+                                            triangle1[1] - triangle1[2]);
+            faceNormals[0][i][j] = glm::normalize(t0Normal);
+            faceNormals[1][i][j] = glm::normalize(t1Normal);
+        }
+    });
+    Parallel::forEach(0, meshResolution - 1, [&](int i)
+    {
+        for(int j = 0; j < meshResolution; j++)
+        {
+            glm::vec3 fNormal = glm::vec3(0.f, 0.f, 0.f);
+
+            // upper left faces
+            if(j != 0 && i != 0)
+            {
+                fNormal += faceNormals[0][i - 1][j - 1] + faceNormals[1][i - 1][j - 1];
+            }
+
+            // upper right faces
+            if(i != 0 && j != meshResolution - 1)
+            {
+                fNormal += faceNormals[0][i - 1][j];
+            }
+
+            // bottom right faces
+            if(i != meshResolution - 1 && j != meshResolution - 1)
+            {
+                fNormal += faceNormals[0][i][j] + faceNormals[1][i][j];
+            }
+
+            // bottom left faces
+            if(i != meshResolution - 1 && j != 0)
+            {
+                fNormal += faceNormals[1][i][j - 1];
+            }
+
+            normals[i * meshResolution + j] = glm::normalize(fNormal);
+        }
+    });
+}
+
+void TerrainMeshBuilder::buildChunkVertices(const std::vector<glm::vec3>
+        &meshVertices, const std::vector<glm::vec3> &meshNormals,
+        const std::vector<glm::vec2> &meshTexCoords, int meshSizeExponent,
+        int chunkSizeExponent, std::vector<glm::vec3> &vertices,
+        std::vector<glm::vec3> &normals, std::vector<glm::vec2> &texCoords)
+{
+    const int meshSize = (1 << meshSizeExponent) + 1;
+    const int chunkSize = (1 << chunkSizeExponent) + 1;
+    const int chunkCount = (meshSize - 1) / (chunkSize - 1);
+    const int chunkVertexCount = chunkSize * chunkSize;
+    vertices.resize(chunkCount * chunkCount * chunkVertexCount);
+    normals.resize(vertices.size());
+    texCoords.resize(vertices.size());
+    // every chunk writes only its own range
+    Parallel::forEach(0, chunkCount * chunkCount, [&](int index)
+    {
+        int x = index % chunkCount;
+        int y = index / chunkCount;
+        int chunkAt = index * chunkVertexCount;
+
+        for(int i = 0; i < chunkSize; i++)
+        {
+            int meshAt = (i + y * (chunkSize - 1)) * meshSize + x * (chunkSize - 1);
+
+            for(int j = 0; j < chunkSize; j++)
+            {
+                vertices[chunkAt + i * chunkSize + j] = meshVertices[meshAt + j];
+                normals[chunkAt + i * chunkSize + j] = meshNormals[meshAt + j];
+                texCoords[chunkAt + i * chunkSize + j] = meshTexCoords[meshAt + j];
+            }
+        }
+    });
+}
+
+void TerrainMeshBuilder::buildChunkBounds(const std::vector<glm::vec3>
+        &meshVertices, int meshSizeExponent, int chunkSizeExponent,
+        std::vector<TerrainSnapshot::ChunkBounds> &bounds)
+{
+    const int meshSize = (1 << meshSizeExponent) + 1;
+    const int chunkSize = (1 << chunkSizeExponent) + 1;
+    const int chunkCount = (meshSize - 1) / (chunkSize - 1);
+    const int halfPoint = chunkSize / 2;
+    const float chunkSpatialSize = (float)(chunkSize - 1) / (meshSize - 1);
+    bounds.resize(chunkCount * chunkCount);
+    // chunks are independent, the height changes are the slow part
+    Parallel::forEach(0, chunkCount * chunkCount, [&](int index)
+    {
+        int x = index % chunkCount;
+        int y = index / chunkCount;
+        std::vector<glm::vec3> chunkVertices(chunkSize * chunkSize);
+        // get maximim and minimum height for current chunk
+        float chunkMaxHeight = 0.0f;
+        float chunkMinHeight = 1.0f;
+
+        for(int i = 0; i < chunkSize; i++)
+        {
+            for(int j = 0; j < chunkSize; j++)
+            {
+                const glm::vec3 &vertex = meshVertices[(i + y * (chunkSize - 1)) * meshSize
+                                                       + j + x * (chunkSize - 1)];
+                chunkVertices[i * chunkSize + j] = vertex;
+                chunkMaxHeight = std::max(vertex.y, chunkMaxHeight);
+                chunkMinHeight = std::min(vertex.y, chunkMinHeight);
+            }
+        }
+
+        TerrainSnapshot::ChunkBounds &chunkBounds = bounds[index];
+        // chunk center vertex, halfway between the lowest and highest point
+        chunkBounds.center = chunkVertices[halfPoint * chunkSize + halfPoint];
+        chunkBounds.center.y = (chunkMaxHeight + chunkMinHeight) / 2.0f;
+        chunkBounds.dimension = glm::vec3(chunkSpatialSize,
+                                          chunkMaxHeight - chunkMinHeight, chunkSpatialSize);
+        chunkHeightChanges(chunkVertices, chunkSize, chunkBounds.heightChange);
+    });
+}
+
+void TerrainMeshBuilder::chunkHeightChanges(const std::vector<glm::vec3>
+        &chunkVertices, int chunkSize, float heightChange[2])
+{
+    // slow calculation for entropies
+    std::vector<glm::vec3> lVertices;
+    std::vector<glm::vec3> hVertices;
+
+    for(int i = 0; i < 2; i++)
+    {
+        if(i == 0) hVertices = chunkVertices;
+        else { hVertices = lVertices; lVertices.clear(); }
+
+        int yStepper = 1;
+        int hChunkLodSize = (chunkSize - 1) / std::pow(2, i) + 1;
+        int lChunkLodSize = (chunkSize - 1) / std::pow(2, i + 1) + 1;
+
+        for(int y = 0; y < hChunkLodSize; y = 2 * yStepper, yStepper++)
+        {
+            int xStepper = 1;
+
+            for(int x = 0; x < hChunkLodSize; x = 2 * xStepper, xStepper++)
+            {
+                lVertices.push_back(hVertices[y * hChunkLodSize + x]);
+            }
+        }
+
+        /************************************************************************/
+        /*
+        x---x---x             x-------x
+        | \ | \ |             | \     |
+        x---x---x  Breaks To  |   \   |
+        | \ | \ |             |     \ |
+        x---x---x             x-------x
+
+        We compare the geometric height error
+        at the vertex loss points, comparing
+        the heigth difference
+        */
+        /************************************************************************/
+        std::vector<float> lHeight;
+        std::vector<float> hHeight;
+
+        for(int y = 0; y < lChunkLodSize; y++)
+        {
+            for(int x = 0; x < lChunkLodSize; x++)
+            {
+                // calculate horizontal lines height loss
+                if(x < lChunkLodSize - 1)
+                {
+                    lHeight.push_back(
+                        glm::lerp(
+                            lVertices[y * lChunkLodSize + x],
+                            lVertices[y * lChunkLodSize + x + 1],
+                            0.5f
+                        ).y
+                    );
+                    // get higher lod original horizontal heights
+                    hHeight.push_back(hVertices[2 * y * hChunkLodSize + 2 * x + 1].y);
+                }
+
+                // calculate vertical height loss
+                if(y < lChunkLodSize - 1)
+                {
+                    lHeight.push_back(
+                        glm::lerp(
+                            lVertices[y * lChunkLodSize + x],
+                            lVertices[(y + 1) * lChunkLodSize + x],
+                            0.5f
+                        ).y
+                    );
+                    // get higher lod original vertical heights
+                    hHeight.push_back(hVertices[(2 * y + 1) * hChunkLodSize + 2 * x].y);
+                }
+
+                // calculate diagonal height loss
+                if(y < lChunkLodSize - 1 && x < lChunkLodSize - 1)
+                {
+                    lHeight.push_back(
+                        glm::lerp(
+                            lVertices[y * lChunkLodSize + x],
+                            lVertices[(y + 1) * lChunkLodSize + x + 1],
+                            0.5f
+                        ).y
+                    );
+                    hHeight.push_back(hVertices[(2 * y + 1) * hChunkLodSize + 2 * x + 1].y);
+                }
+            }
+        }
+
+        float maxEntropy = 0.0f;
+
+        for(int j = 0; j < hHeight.size(); j++)
+        {
+            maxEntropy = std::max(maxEntropy, std::abs(hHeight[i] - lHeight[i]));
+        }
+
+        heightChange[i] = maxEntropy;
+    }
+}
+
+void TerrainMeshBuilder::buildLoDIndices(int meshSize, int chunkSize,
+        std::array<std::vector<unsigned int>, 3> &indices)
+{
+    // triangle strip primitive restart at
+    int restartIndexToken = meshSize * meshSize;
+
+    for(int lodLevel = 0; lodLevel < 3; lodLevel++)
+    {
+        int nextSize = (chunkSize - 1) / std::pow(2, lodLevel) + 1;
+        int stepMultiplier = std::pow(2, lodLevel);
+        indices[lodLevel].clear();
+
+        for(int i = 0; i < nextSize - 1; i++)
+        {
+            for(int j = 0; j < nextSize; j++)
+            {
+                indices[lodLevel].push_back(
+                    ((i + 1) * chunkSize + j) * stepMultiplier
+                );
+                indices[lodLevel].push_back(
+                    (i * chunkSize + j) * stepMultiplier
+                );
+            }
+
+            indices[lodLevel].push_back(restartIndexToken);
+        }
+    }
+}
+
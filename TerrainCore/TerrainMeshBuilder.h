@@ -0,0 +1,44 @@
+#pragma once
+#include "Heightmap.h"
+#include "TerrainSnapshot.h"
+
+// cpu side of the terrain geometry, the whole mesh, chunk bounds and
+// level of detail indices built without any gl calls
+class TerrainMeshBuilder
+{
+    public:
+        // chunks are 2^ChunkSizeExponent + 1 vertices wide
+        static const int ChunkSizeExponent = 4;
+        // height in [0, 1] of a vertex placed over heightmap texel x, y,
+        // the 3x3 box average of its neighbourhood
+        static float vertexHeight(Heightmap &heightmap, int x, int y);
+        // whole mesh at 2^meshResExponent + 1 vertices wide from the
+        // heightmap, a triangle strip restarted at every row
+        static void buildMesh(Heightmap &heightmap, const int meshResExponent,
+                              std::vector<glm::vec3> &vertices,
+                              std::vector<glm::vec3> &normals,
+                              std::vector<glm::vec2> &texCoords,
+                              std::vector<unsigned int> &indices);
+        // the whole mesh buffers split in chunks of 2^chunkSizeExponent + 1
+        // vertices wide, each chunk contiguous and chunks in row order
+        static void buildChunkVertices(const std::vector<glm::vec3> &meshVertices,
+                                       const std::vector<glm::vec3> &meshNormals,
+                                       const std::vector<glm::vec2> &meshTexCoords,
+                                       int meshSizeExponent, int chunkSizeExponent,
+                                       std::vector<glm::vec3> &vertices,
+                                       std::vector<glm::vec3> &normals,
+                                       std::vector<glm::vec2> &texCoords);
+        // bounding box and geomipmapping height changes of every chunk
+        // of 2^chunkSizeExponent + 1 vertices wide, row order
+        static void buildChunkBounds(const std::vector<glm::vec3> &meshVertices,
+                                     int meshSizeExponent, int chunkSizeExponent,
+                                     std::vector<TerrainSnapshot::ChunkBounds> &bounds);
+        // geometric height changes (d) of the chunk vertices when dropping
+        // to the medium and to the low level of detail
+        static void chunkHeightChanges(const std::vector<glm::vec3> &chunkVertices,
+                                       int chunkSize, float heightChange[2]);
+        // index combinations of the 3 LoD levels based on mesh and chunk size
+        static void buildLoDIndices(int meshSize, int chunkSize,
+                                    std::array<std::vector<unsigned int>, 3> &indices);
+};
+
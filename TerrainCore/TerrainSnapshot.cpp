@@ -0,0 +1,176 @@
+#include "Commons.h"
+#include "TerrainSnapshot.h"
+#include "LightmapCompression.h"
+
+const char * TerrainSnapshot::extension = ".tmsnap";
+const size_t TerrainSnapshot::SectionAlignment;
+const std::uint32_t TerrainSnapshot::MaxLightmapSize;
+const std::uint32_t TerrainSnapshot::MaxLightmapSlices;
+
+bool TerrainSnapshot::open(const std::string &filename)
+{
+    close();
+
+    if(!file.open(filename)) return false;
+
+    if(file.Size() < sizeof(Header))
+    {
+        close();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, file.Data(), sizeof(Header));
+
+    const Description &info = header.description;
+
+    // the renderer uses these as they are, the low level of detail
+    // needs a stride of 4 and bc4 whole 4x4 blocks
+    if(std::memcmp(header.magic, "TSNP", 4) != 0
+       || header.version != version
+       || header.sectionCount != SectionCount
+       || info.terrainResolution == 0
+       || info.meshSizeExponent > 15
+       || info.chunkSizeExponent < 2
+       || info.chunkSizeExponent > info.meshSizeExponent
+       || info.lightmapSlices > MaxLightmapSlices
+       || (info.lightmapSlices > 0 && (info.lightmapSize == 0
+                                       || info.lightmapSize > MaxLightmapSize
+                                       || info.lightmapSize % LightmapCompression::BlockSize != 0)))
+    {
+        close();
+        return false;
+    }
+
+    for(int i = 0; i < SectionCount; i++)
+    {
+        const SectionEntry &entry = header.sections[i];
+
+        // misplaced, truncated or sized for a different terrain
+        if(entry.offset % SectionAlignment != 0
+           || entry.offset + entry.size > file.Size()
+           || entry.size != sectionSize(header.description, (Section)i))
+        {
+            close();
+            return false;
+        }
+    }
+
+    this->description = header.description;
+    std::memcpy(this->sections, header.sections, sizeof(sections));
+    return true;
+}
+
+void TerrainSnapshot::close()
+{
+    file.close();
+    std::memset(&description, 0, sizeof(Description));
+    std::memset(sections, 0, sizeof(sections));
+}
+
+size_t TerrainSnapshot::sectionSize(const Description &description,
+                                    Section section)
+{
+    size_t terrainResolution = description.terrainResolution;
+    size_t meshSize = ((size_t)1 << description.meshSizeExponent) + 1;
+    size_t chunkSize = ((size_t)1 << description.chunkSizeExponent) + 1;
+    size_t chunkCount = (meshSize - 1) / (chunkSize - 1);
+
+    switch(section)
+    {
+        case Heights:
+        case MeshHeights:
+            return terrainResolution * terrainResolution * sizeof(float);
+
+        case HeightTexels:
+            return terrainResolution * terrainResolution * 4;
+
+        case NormalMap:
+            return terrainResolution * terrainResolution * 2 * sizeof(std::int16_t);
+
+        case MeshVertices:
+        case MeshNormals:
+            return meshSize * meshSize * sizeof(glm::vec3);
+
+        case MeshTexCoords:
+            return meshSize * meshSize * sizeof(glm::vec2);
+
+        case MeshIndices:
+            return ((meshSize - 1) * meshSize * 2 + meshSize) * sizeof(unsigned int);
+
+        case ChunkVertices:
+        case ChunkNormals:
+            return chunkCount * chunkCount * chunkSize * chunkSize * sizeof(glm::vec3);
+
+        case ChunkTexCoords:
+            return chunkCount * chunkCount * chunkSize * chunkSize * sizeof(glm::vec2);
+
+        case Chunks:
+            return chunkCount * chunkCount * sizeof(ChunkBounds);
+
+        case LoDHigh:
+        case LoDMedium:
+        case LoDLow:
+        {
+            // strip rows of two indices per column plus the restart token
+            size_t levelSize = (chunkSize - 1) / ((size_t)1 << (section - LoDHigh)) + 1;
+            return (levelSize - 1) * (levelSize * 2 + 1) * sizeof(unsigned int);
+        }
+
+        case Lightmaps:
+            return description.lightmapSlices == 0 ? 0
+                   : LightmapCompression::blocksSize(description.lightmapSize)
+                   * description.lightmapSlices;
+
+        default:
+            return 0;
+    }
+}
+
+bool TerrainSnapshot::write(const std::string &filename,
+                            const Description &description, const void * const data[SectionCount])
+{
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, "TSNP", 4);
+    header.version = version;
+    header.sectionCount = SectionCount;
+    header.description = description;
+    std::uint64_t offset = SectionAlignment;
+
+    for(int i = 0; i < SectionCount; i++)
+    {
+        header.sections[i].offset = offset;
+        header.sections[i].size = sectionSize(description, (Section)i);
+        offset += (header.sections[i].size + SectionAlignment - 1)
+                  / SectionAlignment * SectionAlignment;
+    }
+
+    return MappedFile::replace(filename, [&](std::ostream & output)
+    {
+        const std::vector<char> padding(SectionAlignment, 0);
+        output.write((const char *)&header, sizeof(Header));
+        output.write(padding.data(), SectionAlignment - sizeof(Header));
+
+        for(int i = 0; i < SectionCount; i++)
+        {
+            size_t size = (size_t)header.sections[i].size;
+
+            if(size == 0) continue;
+
+            output.write((const char *)data[i], size);
+            output.write(padding.data(), (SectionAlignment - size % SectionAlignment)
+                         % SectionAlignment);
+        }
+    });
+}
+
+TerrainSnapshot::TerrainSnapshot()
+{
+    std::memset(&description, 0, sizeof(Description));
+    std::memset(sections, 0, sizeof(sections));
+}
+
+TerrainSnapshot::~TerrainSnapshot()
+{
+}
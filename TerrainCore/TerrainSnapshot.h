@@ -0,0 +1,106 @@
+#pragma once
+#include "MappedFile.h"
+
+// whole terrain state in one .tmsnap file, every section starts at a page
+// boundary so it's used straight from the mapping, buffers are uploaded
+// from it without any parsing
+class TerrainSnapshot
+{
+    public:
+        enum Section
+        {
+            // raw heightmap values in [-1, 1]
+            Heights = 0,
+            // heightmap texture, rgba texels as Heightmap::RawImage renders them
+            HeightTexels,
+            // filtered mesh heights in [0, 1] and the snorm16 x, z normal
+            // map baked from them
+            MeshHeights,
+            NormalMap,
+            // whole mesh buffers as createMesh uploads them
+            MeshVertices,
+            MeshNormals,
+            MeshTexCoords,
+            MeshIndices,
+            // chunk buffers one whole chunk after the other, row order
+            ChunkVertices,
+            ChunkNormals,
+            ChunkTexCoords,
+            // one ChunkBounds per chunk, row order
+            Chunks,
+            // chunk index combinations per level of detail
+            LoDHigh,
+            LoDMedium,
+            LoDLow,
+            // bc4 blocks of every time of the day slice, may be empty
+            Lightmaps,
+            SectionCount
+        };
+        // parameters the terrain was generated with
+        struct Description
+        {
+            std::uint32_t terrainResolution;
+            std::uint32_t meshSizeExponent;
+            std::uint32_t chunkSizeExponent;
+            std::int32_t seed;
+            float sampleSquare[3];
+            std::uint32_t lightmapSize;
+            std::uint32_t lightmapSlices;
+            // BakeCache::hash of the heights clamped to [0, 1]
+            std::uint64_t heightHash;
+        };
+        // bounding box and geomipmapping height changes of a chunk
+        struct ChunkBounds
+        {
+            glm::vec3 center;
+            glm::vec3 dimension;
+            float heightChange[2];
+        };
+        static const char * extension;
+    private:
+        // bump when the file layout changes
+        static const std::uint32_t version = 2;
+        static const size_t SectionAlignment = 4096;
+        // largest lightmaps the renderer bakes, array layers every gl 4
+        // driver supports
+        static const std::uint32_t MaxLightmapSize = 4096;
+        static const std::uint32_t MaxLightmapSlices = 2048;
+        struct SectionEntry
+        {
+            std::uint64_t offset;
+            std::uint64_t size;
+        };
+        struct Header
+        {
+            char magic[4];
+            std::uint32_t version;
+            std::uint32_t sectionCount;
+            Description description;
+            SectionEntry sections[SectionCount];
+        };
+        MappedFile file;
+        Description description;
+        SectionEntry sections[SectionCount];
+    public:
+        // maps filename, false if missing, malformed or any section
+        // doesn't have the size its description implies
+        bool open(const std::string &filename);
+        void close();
+
+        const Description &Info() const { return description; }
+        const unsigned char * SectionData(Section section) const
+        {
+            return file.Data() + sections[section].offset;
+        }
+        size_t SectionSize(Section section) const { return (size_t)sections[section].size; }
+
+        // bytes the given section takes for a terrain of description
+        static size_t sectionSize(const Description &description, Section section);
+        // writes every section, data[i] holds sectionSize bytes for section i
+        static bool write(const std::string &filename, const Description &description,
+                          const void * const data[SectionCount]);
+
+        TerrainSnapshot();
+        ~TerrainSnapshot();
+};
+
@@ -0,0 +1,203 @@
+#include "Commons.h"
+#include "TextureContainer.h"
+#include "Parallel.h"
+
+const char * TextureContainer::extension = ".tmtex";
+
+bool TextureContainer::open(const std::string &filename)
+{
+    close();
+
+    if(!file.open(filename)) return false;
+
+    if(file.Size() < sizeof(Header))
+    {
+        close();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, file.Data(), sizeof(Header));
+
+    if(std::memcmp(header.magic, "TMTX", 4) != 0
+       || header.version != version
+       || header.format != BC1
+       || header.width == 0 || header.height == 0
+       || header.levels == 0 || header.levels > 32)
+    {
+        close();
+        return false;
+    }
+
+    this->width = header.width;
+    this->height = header.height;
+    size_t offset = sizeof(Header);
+
+    for(std::uint32_t level = 0; level < header.levels; level++)
+    {
+        size_t size = LevelSize(level);
+
+        // truncated file
+        if(offset + size > file.Size())
+        {
+            close();
+            return false;
+        }
+
+        levelData.push_back(file.Data() + offset);
+        offset += size;
+    }
+
+    return true;
+}
+
+void TextureContainer::close()
+{
+    file.close();
+    levelData.clear();
+    width = height = 0;
+}
+
+size_t TextureContainer::levelSize(int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+bool TextureContainer::isContainer(const std::string &filename)
+{
+    size_t length = std::strlen(extension);
+    return filename.size() >= length
+           && filename.compare(filename.size() - length, length, extension) == 0;
+}
+
+std::string TextureContainer::containerPath(const std::string &filename)
+{
+    size_t separator = filename.find_last_of("/\\");
+    size_t dot = filename.find_last_of('.');
+
+    // no extension to replace
+    if(dot == std::string::npos
+       || (separator != std::string::npos && dot < separator))
+    {
+        return filename + extension;
+    }
+
+    return filename.substr(0, dot) + extension;
+}
+
+bool TextureContainer::write(const std::string &filename, int width,
+                             int height, const std::vector<std::vector<unsigned char>> &levels)
+{
+    if(levels.empty()) return false;
+
+    for(unsigned int level = 0; level < levels.size(); level++)
+    {
+        if(levels[level].size() != levelSize(std::max(1, width >> level),
+                                             std::max(1, height >> level))) return false;
+    }
+
+    Header header;
+    std::memcpy(header.magic, "TMTX", 4);
+    header.version = version;
+    header.format = BC1;
+    header.width = width;
+    header.height = height;
+    header.levels = (std::uint32_t)levels.size();
+    return MappedFile::replace(filename, [&](std::ostream & output)
+    {
+        output.write((const char *)&header, sizeof(Header));
+
+        for(auto &level : levels)
+        {
+            output.write((const char *)level.data(), level.size());
+        }
+    });
+}
+
+void TextureContainer::encodeBC1(const unsigned char * bgr, int width,
+                                 int height, unsigned char * blocks)
+{
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    Parallel::forEach(0, blocksY, [&](int by)
+    {
+        for(int bx = 0; bx < blocksX; bx++)
+        {
+            // rgb texels, partial blocks repeat the border
+            int texels[16][3];
+            int low[3] = { 255, 255, 255 };
+            int high[3] = { 0, 0, 0 };
+
+            for(int i = 0; i < 16; i++)
+            {
+                int x = std::min(bx * 4 + i % 4, width - 1);
+                int y = std::min(by * 4 + i / 4, height - 1);
+                const unsigned char * texel = bgr + (y * width + x) * 3;
+
+                for(int c = 0; c < 3; c++)
+                {
+                    texels[i][c] = texel[2 - c];
+                    low[c] = std::min(low[c], texels[i][c]);
+                    high[c] = std::max(high[c], texels[i][c]);
+                }
+            }
+
+            // inset the box, its corners are usually outliers
+            for(int c = 0; c < 3; c++)
+            {
+                int inset = (high[c] - low[c]) / 16;
+                high[c] -= inset;
+                low[c] += inset;
+            }
+
+            std::uint16_t color0 = (std::uint16_t)((high[0] >> 3) << 11
+                                                   | (high[1] >> 2) << 5 | high[2] >> 3);
+            std::uint16_t color1 = (std::uint16_t)((low[0] >> 3) << 11
+                                                   | (low[1] >> 2) << 5 | low[2] >> 3);
+
+            // color0 > color1 selects the four color mode
+            if(color0 < color1) std::swap(color0, color1);
+
+            std::uint32_t indices = 0;
+
+            if(color0 != color1)
+            {
+                // endpoints as the hardware decodes them
+                int end0[3] = { (color0 >> 11) << 3, ((color0 >> 5) & 63) << 2, (color0 & 31) << 3 };
+                int end1[3] = { (color1 >> 11) << 3, ((color1 >> 5) & 63) << 2, (color1 & 31) << 3 };
+                int axis[3] = { end0[0] - end1[0], end0[1] - end1[1], end0[2] - end1[2] };
+                float length2 = (float)(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+                for(int i = 0; i < 16; i++)
+                {
+                    float t = ((texels[i][0] - end1[0]) * axis[0]
+                               + (texels[i][1] - end1[1]) * axis[1]
+                               + (texels[i][2] - end1[2]) * axis[2]) / length2;
+                    int step = (int)(std::min(std::max(t, 0.0f), 1.0f) * 3.0f + 0.5f);
+                    // index 0 is color0, 1 color1, 2 and 3 the thirds between
+                    std::uint32_t index = step == 3 ? 0 : step == 0 ? 1 : step == 2 ? 2 : 3;
+                    indices |= index << (2 * i);
+                }
+            }
+
+            unsigned char * block = blocks + (by * blocksX + bx) * 8;
+            block[0] = (unsigned char)color0;
+            block[1] = (unsigned char)(color0 >> 8);
+            block[2] = (unsigned char)color1;
+            block[3] = (unsigned char)(color1 >> 8);
+
+            for(int i = 0; i < 4; i++)
+            {
+                block[4 + i] = (unsigned char)(indices >> (8 * i));
+            }
+        }
+    });
+}
+
+TextureContainer::TextureContainer() : width(0), height(0)
+{
+}
+
+TextureContainer::~TextureContainer()
+{
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "MappedFile.h"
+
+// pre-resized texture with its whole mip chain stored as bc1 blocks, the
+// .tmtex file is mapped and every level uploaded straight from the mapping
+class TextureContainer
+{
+    public:
+        enum Format
+        {
+            BC1 = 1
+        };
+        static const char * extension;
+    private:
+        // bump when the file layout changes
+        static const std::uint32_t version = 1;
+        struct Header
+        {
+            char magic[4];
+            std::uint32_t version;
+            std::uint32_t format;
+            std::uint32_t width;
+            std::uint32_t height;
+            std::uint32_t levels;
+        };
+        MappedFile file;
+        int width;
+        int height;
+        // levels are stored finest first, one after the other
+        std::vector<const unsigned char *> levelData;
+    public:
+        // maps filename, false if missing or malformed
+        bool open(const std::string &filename);
+        void close();
+
+        int Width() const { return width; }
+        int Height() const { return height; }
+        int LevelCount() const { return (int)levelData.size(); }
+        const unsigned char * LevelData(int level) const { return levelData[level]; }
+        size_t LevelSize(int level) const
+        {
+            return levelSize(std::max(1, width >> level), std::max(1, height >> level));
+        }
+
+        // bytes of a bc1 level, partial blocks are padded
+        static size_t levelSize(int width, int height);
+        // true if filename has the container extension
+        static bool isContainer(const std::string &filename);
+        // same file name with the container extension
+        static std::string containerPath(const std::string &filename);
+        // writes bc1 levels, finest first, each halving the previous one
+        static bool write(const std::string &filename, int width, int height,
+                          const std::vector<std::vector<unsigned char>> &levels);
+        // bc1 blocks in row order of width * height bgr texels, endpoints
+        // are the inset bounding box of each block
+        static void encodeBC1(const unsigned char * bgr, int width, int height,
+                              unsigned char * blocks);
+
+        TextureContainer();
+        ~TextureContainer();
+};
+